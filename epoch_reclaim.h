@@ -0,0 +1,151 @@
+#ifndef EPOCH_RECLAIM_H
+#define EPOCH_RECLAIM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+/************ Освобождение памяти по эпохам **************/
+
+/*
+ * Номера потоков-читателей на весь процесс: каждый поток при первом чтении
+ * занимает свободный номер и отдаёт его при завершении. Если номера
+ * кончились, поток получает none и читает под замком писателя.
+ */
+class ReaderSlots {
+  public:
+    static constexpr size_t max_readers = 256;
+    static constexpr size_t none = static_cast<size_t>(-1);
+
+    static size_t current() {
+        thread_local Registration registration;
+        return registration.index;
+    }
+
+    // Верхняя граница занятых номеров: писателю не нужно смотреть дальше
+    static size_t used_bound() {
+        return bound().load(std::memory_order_acquire);
+    }
+
+  private:
+    struct Registration {
+        Registration() {
+            for (size_t i = 0; i < max_readers; i++) {
+                bool expected = false;
+                if (taken()[i].compare_exchange_strong(expected, true)) {
+                    index = i;
+                    size_t used = bound().load();
+                    while (used < i + 1 && !bound().compare_exchange_weak(used, i + 1)) {}
+                    return;
+                }
+            }
+        }
+
+        ~Registration() {
+            if (index != none) {
+                taken()[index].store(false, std::memory_order_release);
+            }
+        }
+
+        size_t index = none;
+    };
+
+    static std::atomic<bool>* taken() {
+        static std::atomic<bool> slots[max_readers] = {};
+        return slots;
+    }
+
+    static std::atomic<size_t>& bound() {
+        static std::atomic<size_t> used{0};
+        return used;
+    }
+};
+
+/*
+ * Читатель на время чтения объявляет текущую эпоху в своей строке,
+ * писатель помечает снятую с публикации память эпохой снятия и отдаёт её,
+ * только когда все объявленные эпохи новее метки.
+ */
+class EpochDomain {
+  public:
+    EpochDomain() : readers(new ReaderEpoch[ReaderSlots::max_readers]) {}
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Номер читателя для leave или ReaderSlots::none - тогда читать нужно под замком
+    size_t enter() const {
+        size_t slot = ReaderSlots::current();
+        if (slot != ReaderSlots::none) {
+            // Объявление эпохи должно стать видно до чтения опубликованных указателей
+            readers[slot].epoch.store(epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+        return slot;
+    }
+
+    void leave(size_t slot) const {
+        readers[slot].epoch.store(0, std::memory_order_release);
+    }
+
+    // Метка для памяти, уже снятой с публикации: её не увидят читатели,
+    // пришедшие после сдвига эпохи
+    uint64_t advance() {
+        return epoch.fetch_add(1);
+    }
+
+    // Память с меткой меньше результата не видит ни один читатель
+    uint64_t oldest_reader() const {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t oldest = static_cast<uint64_t>(-1);
+        for (size_t i = 0; i < ReaderSlots::used_bound(); i++) {
+            uint64_t reader_epoch = readers[i].epoch.load(std::memory_order_acquire);
+            if (reader_epoch != 0) {
+                oldest = std::min(oldest, reader_epoch);
+            }
+        }
+        return oldest;
+    }
+
+  private:
+    struct alignas(64) ReaderEpoch {
+        std::atomic<uint64_t> epoch{0};  // 0 - поток сейчас не читает
+    };
+
+    std::atomic<uint64_t> epoch{1};
+    std::unique_ptr<ReaderEpoch[]> readers;
+};
+
+// Снятая писателем память ждёт, пока её перестанут видеть читатели.
+// Список принадлежит одному писателю и правится под его замком
+class RetireList {
+  public:
+    void retire(uint64_t epoch, std::shared_ptr<void> memory) {
+        retired.push_back({epoch, std::move(memory)});
+    }
+
+    bool empty() const {
+        return retired.empty();
+    }
+
+    void reclaim(const EpochDomain& domain) {
+        uint64_t oldest = domain.oldest_reader();
+        auto alive = std::remove_if(retired.begin(), retired.end(),
+            [oldest](const Retired& old) { return old.epoch < oldest; });
+        retired.erase(alive, retired.end());
+    }
+
+  private:
+    struct Retired {
+        uint64_t epoch;
+        std::shared_ptr<void> memory;
+    };
+
+    std::vector<Retired> retired;
+};
+
+#endif  // EPOCH_RECLAIM_H
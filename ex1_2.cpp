@@ -1,5 +1,29 @@
 #include <iostream>
+#include <cstdio>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#include "epoch_reclaim.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define ALREADY_EXIST -1
 #define NOT_EXIST -2
@@ -10,16 +34,69 @@ static const size_t primary_size = 8;
 template<typename T>
 class Hash;
 
+/*
+ * Семейство 64-битных хешей строк: ключ читается словами по 8 байт,
+ * слова перемешиваются 128-битным умножением. Разные seed дают
+ * независимые функции семейства.
+ */
 template<>
 class Hash<std::string> {
   public:
-    size_t operator()(const std::string& val, size_t table_size) {
-        size_t hash = 0;
-        for (auto i : val) {
-            hash = static_cast<size_t>(hash * 127 + i) % table_size;
+    explicit Hash(uint64_t seed = 0) : seed(seed) {}
+
+    size_t operator()(std::string_view val) const {
+        return static_cast<size_t>(hash_bytes(val.data(), val.size()));
+    }
+
+  private:
+    static constexpr uint64_t secret0 = 0xa0761d6478bd642fULL;
+    static constexpr uint64_t secret1 = 0xe7037ed1a0b428dbULL;
+    static constexpr uint64_t secret2 = 0x8ebc6af09c88c6e3ULL;
+
+    static uint64_t mix(uint64_t a, uint64_t b) {
+        __uint128_t product = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+    }
+
+    static uint64_t read64(const char* ptr) {
+        uint64_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+        return word;
+    }
+
+    static uint64_t read32(const char* ptr) {
+        uint32_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+        return word;
+    }
+
+    uint64_t hash_bytes(const char* data, size_t len) const {
+        uint64_t hash = seed ^ mix(seed ^ secret0, secret1);
+        size_t rest = len;
+        while (rest > 16) {
+            hash = mix(read64(data) ^ secret1, read64(data + 8) ^ hash);
+            data += 16;
+            rest -= 16;
+        }
+
+        // Хвост до 16 байт читается двумя перекрывающимися словами
+        uint64_t a = 0;
+        uint64_t b = 0;
+        if (rest > 8) {
+            a = read64(data);
+            b = read64(data + rest - 8);
+        } else if (rest >= 4) {
+            a = read32(data);
+            b = read32(data + rest - 4);
+        } else if (rest > 0) {
+            a = (static_cast<uint64_t>(static_cast<unsigned char>(data[0])) << 16) |
+                (static_cast<uint64_t>(static_cast<unsigned char>(data[rest >> 1])) << 8) |
+                static_cast<unsigned char>(data[rest - 1]);
         }
-        return hash + 1;
+        return mix(secret2 ^ len, mix(a ^ secret1, b ^ hash));
     }
+
+    uint64_t seed;
 };
 
 
@@ -29,35 +106,272 @@ class Comp;
 template<>
 class Comp<std::string> {
   public:
-    bool operator()(const std::string& str1, const std::string& str2) {
+    bool operator()(std::string_view str1, std::string_view str2) const {
         return str1 == str2;
     }
 };
 
 
+// Параметры перестроения таблицы
+struct HashTableConfig {
+    bool incremental_rehash = false;    // Переносить слоты в новую таблицу понемногу
+    size_t rehash_step = 4;             // Число слотов старой таблицы, переносимых за операцию
+    double max_deleted_rate = 0.25;     // Доля удалённых слотов, после которой таблица перестраивается
+    double shrink_rate = 0.125;         // Заполненность, ниже которой таблица уменьшается вдвое (0 - никогда)
+};
+
+
+// Поля слотов, которые ConcurrentHashTable читает без замка, пишутся
+// и читаются атомарно; на x86 это обычные mov. Прочие типы пишутся как есть
+template<typename T>
+constexpr bool is_lock_free_field = std::is_trivially_copyable_v<T> &&
+    (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+template<typename T>
+void shared_store(T& field, T value) {
+    if constexpr (is_lock_free_field<T>) {
+        __atomic_store(&field, &value, __ATOMIC_RELEASE);
+    } else {
+        field = std::move(value);
+    }
+}
+
+template<typename T>
+T shared_load(const T& field) {
+    static_assert(is_lock_free_field<T>, "field is not readable without a lock");
+    T value;
+    __atomic_load(&field, &value, __ATOMIC_ACQUIRE);
+    return value;
+}
+
+
+// Ключи хранятся прямо в слотах таблицы
+template<typename Value>
+class InlineKeys {
+  public:
+    using Key = Value;
+
+    // Ключ целиком копируется одной атомарной загрузкой
+    static constexpr bool optimistic_reads = is_lock_free_field<Value>;
+
+    // Ключи в самих слотах: читателю не нужно ничего, кроме таблицы
+    struct Snapshot {
+        bool operator!=(const Snapshot&) const {
+            return false;
+        }
+    };
+
+    template<typename K>
+    Key store(const K& val) {
+        return Key(val);
+    }
+
+    template<typename K>
+    bool can_store(const K&) const {
+        return true;
+    }
+
+    const Value& view(const Key& key) const {
+        return key;
+    }
+
+    // Читатели ConcurrentHashTable могут в это время снимать ключ через shared_load
+    void release(Key& key) {
+        shared_store(key, Key());
+    }
+
+    bool needs_compaction() const {
+        return false;
+    }
+
+    template<typename ForEachKey>
+    void compact(ForEachKey) {}
+
+    Snapshot snapshot() const {
+        return {};
+    }
+
+    static const Value& view_in(const Snapshot&, const Key& key) {
+        return key;
+    }
+
+    void defer_frees(std::vector<std::shared_ptr<void>>*) {}
+};
+
+
+/*
+ * Байты строк лежат подряд в арене, принадлежащей таблице,
+ * слот хранит только смещение и длину. Место удалённых строк
+ * возвращается уплотнением, когда мёртвых байтов больше живых.
+ * Смещение (40 бит) и длина (24 бита) упакованы в одно 64-битное слово,
+ * которое читатель снимает одной загрузкой: арена до 1 ТиБ, ключ
+ * до 16 МиБ. Перед переполнением таблица уплотняет арену, а если
+ * живых байтов всё равно слишком много, store бросает std::length_error.
+ * Записанные байты не меняются, пока буфер жив: читатель без замка
+ * видит либо старый буфер целиком, либо новый.
+ */
+class ArenaKeys {
+  public:
+    struct Key {
+        static constexpr unsigned offset_bits = 40;
+        static constexpr uint64_t max_offset = (static_cast<uint64_t>(1) << offset_bits) - 1;
+        static constexpr uint64_t max_length = (static_cast<uint64_t>(1) << (64 - offset_bits)) - 1;
+
+        constexpr Key() = default;
+        constexpr Key(uint64_t offset, uint64_t length) : packed(length << offset_bits | offset) {}
+
+        constexpr size_t offset() const {
+            return packed & max_offset;
+        }
+
+        constexpr size_t length() const {
+            return packed >> offset_bits;
+        }
+
+        uint64_t packed = 0;
+    };
+
+    static constexpr bool optimistic_reads = true;
+
+    // Буфер с его размером, снятые вместе
+    struct Snapshot {
+        const char* data = nullptr;
+        size_t capacity = 0;
+
+        bool operator!=(const Snapshot& other) const {
+            return data != other.data || capacity != other.capacity;
+        }
+    };
+
+    Key store(std::string_view val) {
+        if (!can_store(val)) {
+            throw std::length_error("ArenaKeys: key longer than 16 MiB or arena exceeds 1 TiB");
+        }
+        reserve(used + val.size());
+        Key key(used, val.size());
+        std::memcpy(arena.get() + used, val.data(), val.size());
+        used += val.size();
+        return key;
+    }
+
+    std::string_view view(const Key& key) const {
+        return std::string_view(arena.get() + key.offset(), key.length());
+    }
+
+    // Смещение и длина каждого ключа должны уместиться в свои поля Key
+    bool can_store(std::string_view val) const {
+        return val.size() <= Key::max_length && val.size() <= max_bytes - used;
+    }
+
+    // Слот уже помечен удалённым, поэтому сам ключ не трогается
+    void release(const Key& key) {
+        dead_bytes += key.length();
+    }
+
+    bool needs_compaction() const {
+        return dead_bytes > min_compaction_bytes && 2 * dead_bytes > used;
+    }
+
+    // for_each_key обходит все живые ключи таблицы и передаёт каждый в visit
+    template<typename ForEachKey>
+    void compact(ForEachKey for_each_key) {
+        size_t fresh_capacity = std::max(used - dead_bytes, min_capacity);
+        std::unique_ptr<char[]> fresh(new char[fresh_capacity]());
+        size_t fresh_used = 0;
+        for_each_key([&](Key& key) {
+            std::memcpy(fresh.get() + fresh_used, arena.get() + key.offset(), key.length());
+            shared_store(key, Key(fresh_used, key.length()));
+            fresh_used += key.length();
+        });
+        replace_buffer(std::move(fresh), fresh_capacity);
+        used = fresh_used;
+        dead_bytes = 0;
+    }
+
+    Snapshot snapshot() const {
+        return {arena.get(), capacity};
+    }
+
+    // Ключ из разорванного чтения может указывать за буфер снимка - тогда пустой вид,
+    // а результат всё равно отбросит проверка версии
+    static std::string_view view_in(const Snapshot& snapshot, const Key& key) {
+        if (key.offset() + key.length() > snapshot.capacity) {
+            return std::string_view();
+        }
+        return std::string_view(snapshot.data + key.offset(), key.length());
+    }
+
+    // Вместо освобождения старые буферы складываются в retired
+    void defer_frees(std::vector<std::shared_ptr<void>>* retired_list) {
+        retired = retired_list;
+    }
+
+  private:
+    static constexpr size_t min_compaction_bytes = 4096;
+    static constexpr size_t min_capacity = 64;
+    static constexpr size_t max_bytes = Key::max_offset;
+
+    void reserve(size_t required) {
+        if (required <= capacity) {
+            return;
+        }
+        size_t fresh_capacity = std::max({required, 2 * capacity, min_capacity});
+        std::unique_ptr<char[]> fresh(new char[fresh_capacity]());
+        if (used) {
+            std::memcpy(fresh.get(), arena.get(), used);
+        }
+        replace_buffer(std::move(fresh), fresh_capacity);
+    }
+
+    void replace_buffer(std::unique_ptr<char[]> fresh, size_t fresh_capacity) {
+        arena.swap(fresh);
+        capacity = fresh_capacity;
+        if (retired && fresh) {
+            retired->emplace_back(fresh.release(), [](void* buffer) { delete [] static_cast<char*>(buffer); });
+        }
+    }
+
+    std::unique_ptr<char[]> arena;
+    size_t used = 0;
+    size_t capacity = 0;
+    size_t dead_bytes = 0;
+    std::vector<std::shared_ptr<void>>* retired = nullptr;
+};
+
+// Смещение за старым пределом 4 ГиБ и наибольшая длина переживают упаковку
+static_assert(ArenaKeys::Key((static_cast<uint64_t>(5) << 32) + 7, ArenaKeys::Key::max_length).offset() ==
+              (static_cast<uint64_t>(5) << 32) + 7, "arena key offset round-trip");
+static_assert(ArenaKeys::Key((static_cast<uint64_t>(5) << 32) + 7, ArenaKeys::Key::max_length).length() ==
+              ArenaKeys::Key::max_length, "arena key length round-trip");
+static_assert(sizeof(ArenaKeys::Key) == 8 && is_lock_free_field<ArenaKeys::Key>, "arena key is one word");
+
+
 template<
     typename Value,
-    typename Hash1 = Hash<Value>,
-    typename Hash2 = Hash<Value>,
-    typename Comp = Comp<Value>
+    typename Hash = Hash<Value>,
+    typename Comp = Comp<Value>,
+    typename Keys = InlineKeys<Value>
 >
 class HashTable {    
   public:
     
     struct Node {
-      Value val;
+      typename Keys::Key val;
+      size_t hash = 0;    // Полный хеш ключа, чтобы не пересчитывать его
       bool is_deleted = false;
       bool is_empty = true;
     };
     
-    HashTable(Hash1 hash1 = Hash1(), Hash2 hash2 = Hash2() , Comp comp = Comp())
+    HashTable(Hash hash = Hash(), Comp comp = Comp(), HashTableConfig config = HashTableConfig())
     :
-    hash1(hash1),
-    hash2(hash2),
+    hash(hash),
     comp(comp),
+    config(config),
     max_keys_count(primary_size) {
         table = new Node[max_keys_count];
     }
+
+    explicit HashTable(HashTableConfig config) : HashTable(Hash(), Comp(), config) {}
     
     
     HashTable(const HashTable&) = delete;
@@ -66,6 +380,7 @@ class HashTable {
     HashTable& operator=(HashTable&&) = delete;
     
     ~HashTable() {
+        delete [] old_table;
         delete [] table;
     }
 
@@ -77,129 +392,1150 @@ class HashTable {
         return items_count;
     }
 
-    bool in_table(Value& val) {
-        size_t i = 0;
-        size_t idx = hash(val, i);
-        while (i < max_keys_count && table[idx].is_empty == false) {
-            if (table[idx].val == val && table[idx].is_deleted == false) {
-                return true;
+    // Идёт ли перенос ключей из старой таблицы
+    bool is_rehashing() const {
+        return old_table != nullptr;
+    }
+
+    size_t deleted_size() const {
+        return deleted_count;
+    }
+
+    size_t capacity() const {
+        return max_keys_count;
+    }
+
+    // Ключ - любой тип, который принимают Hash и Comp (например, string_view)
+    template<typename K>
+    bool in_table(const K& val) {
+        migrate_step();
+        return contains_hashed(val, hash(val));
+    }
+
+    // Не переносит слоты, поэтому безопасна для одновременных читателей
+    template<typename K>
+    bool in_table(const K& val) const {
+        return contains_hashed(val, hash(val));
+    }
+
+    template<typename K>
+    ssize_t push(const K& val) {
+        migrate_step();
+        return push_hashed(val, hash(val));
+    }
+
+    template<typename K>
+    ssize_t pop(const K& val) {
+        migrate_step();
+        return pop_hashed(val, hash(val));
+    }
+
+    // Пакетная проверка: сначала хешируется весь пакет и запрашиваются
+    // домашние слоты, затем идёт разбор пробирования
+    void contains_many(const Value* vals, size_t count, bool* out) {
+        size_t hashes[batch_size];
+        for (size_t begin = 0; begin < count; begin += batch_size) {
+            size_t n = std::min(batch_size, count - begin);
+            if (old_table) {
+                migrate(config.rehash_step * n);
+            }
+            prefetch_batch(vals + begin, n, hashes);
+
+            for (size_t i = 0; i < n; i++) {
+                const Value& val = vals[begin + i];
+                out[begin + i] = find(old_table, old_max_keys_count, val, hashes[i]) != npos ||
+                                 find(table, max_keys_count, val, hashes[i]) != npos;
             }
-            i++;
-            idx = hash(val, i);
         }
-        return false;
     }
 
-    ssize_t push(Value& val) {
-        if (items_count >= max_keys_count * fill_rate) {
-            grow();
+    // Пакетная вставка, коды возврата как у push
+    void insert_many(const Value* vals, size_t count, ssize_t* out) {
+        size_t hashes[batch_size];
+        for (size_t begin = 0; begin < count; begin += batch_size) {
+            size_t n = std::min(batch_size, count - begin);
+            if (old_table) {
+                migrate(config.rehash_step * n);
+            }
+            // Место под весь пакет готовится заранее, чтобы запрошенные слоты не устарели
+            if (items_count + deleted_count + n >= max_keys_count * fill_rate) {
+                size_t new_max_keys_count = max_keys_count;
+                while ((items_count + n) * 2 >= new_max_keys_count * fill_rate) {
+                    new_max_keys_count *= 2;
+                }
+                resize(new_max_keys_count);
+            }
+            prefetch_batch(vals + begin, n, hashes);
+
+            for (size_t i = 0; i < n; i++) {
+                const Value& val = vals[begin + i];
+                size_t h = hashes[i];
+                if (find(old_table, old_max_keys_count, val, h) != npos ||
+                    find(table, max_keys_count, val, h) != npos) {
+                    out[begin + i] = ALREADY_EXIST;
+                    continue;
+                }
+                place(free_slot(table, max_keys_count, h), store_key(val), h);
+                items_count++;
+                out[begin + i] = 0;
+            }
         }
-        if (in_table(val)) {
+    }
+
+  private:
+    template<typename, typename, typename, typename>
+    friend class ConcurrentHashTable;
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t batch_size = 64;
+
+    template<typename K>
+    bool contains_hashed(const K& val, size_t h) const {
+        return find(old_table, old_max_keys_count, val, h) != npos ||
+               find(table, max_keys_count, val, h) != npos;
+    }
+
+    template<typename K>
+    ssize_t push_hashed(const K& val, size_t h) {
+        if (contains_hashed(val, h)) {
             // Если такой элемент уже есть, ошибка
             return ALREADY_EXIST;
         }
-        size_t i = 0;
-        size_t idx = hash(val, i);
-        while (i < max_keys_count && table[idx].is_empty == false) {
+        if (items_count + deleted_count >= max_keys_count * fill_rate) {
+            // Если заметную часть занятых слотов держат надгробия, хватает перестроения без роста
+            resize(2 * items_count >= max_keys_count * fill_rate ? 2 * max_keys_count : max_keys_count);
+        }
+
+        size_t idx = free_slot(table, max_keys_count, h);
+        if (idx == npos) {
+            resize(2 * max_keys_count);
+            finish_rehash();
+            return push_hashed(val, h);
+        }
+
+        place(idx, store_key(val), h);
+        items_count++;
+        return 0;
+    }
 
-            if (table[idx].val == val && table[idx].is_deleted == false) {
-                return ALREADY_EXIST;
+    template<typename K>
+    ssize_t pop_hashed(const K& val, size_t h) {
+        Node* nodes = old_table;
+        size_t idx = find(old_table, old_max_keys_count, val, h);
+        if (idx == npos) {
+            nodes = table;
+            idx = find(table, max_keys_count, val, h);
+        }
+        if (idx == npos) {
+            return NOT_EXIST;
+        }
+
+        shared_store(nodes[idx].is_deleted, true);
+        keys.release(nodes[idx].val);
+        items_count--;
+        if (nodes == table) {
+            deleted_count++;
+        }
+        if (keys.needs_compaction()) {
+            compact_keys();
+        }
+
+        if (!old_table) {
+            if (max_keys_count > primary_size && items_count < max_keys_count * config.shrink_rate) {
+                resize(max_keys_count / 2);
+            } else if (deleted_count >= max_keys_count * config.max_deleted_rate) {
+                resize(max_keys_count);
             }
-            if (table[idx].is_deleted == true) {
-                table[idx].val = val;
-                table[idx].is_deleted = false;
-                table[idx].is_empty = false;
-                items_count++;
-                return 0;
+        }
+        return 0;
+    }
+
+    // Уплотнение освобождает место мёртвых ключей до того, как арена упрётся в предел
+    template<typename K>
+    typename Keys::Key store_key(const K& val) {
+        if (!keys.can_store(val)) {
+            compact_keys();
+        }
+        return keys.store(val);
+    }
+
+    void prefetch_batch(const Value* vals, size_t count, size_t* hashes) {
+        for (size_t i = 0; i < count; i++) {
+            hashes[i] = hash(vals[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            __builtin_prefetch(&table[probe(hashes[i], 0, max_keys_count)]);
+            if (old_table) {
+                __builtin_prefetch(&old_table[probe(hashes[i], 0, old_max_keys_count)]);
+            }
+        }
+    }
+
+    // Размер таблицы - степень двойки, нечётный шаг обходит все слоты
+    static size_t probe(size_t h, size_t i, size_t keys_count) {
+        return (h + i * ((h >> 32) | 1)) & (keys_count - 1);
+    }
+
+    // Сравнение хешей отсекает почти все несовпадения до сравнения ключей
+    template<typename K>
+    bool same_key(const Node& node, const K& val, size_t h) const {
+        return node.hash == h && node.is_deleted == false && comp(keys.view(node.val), val);
+    }
+
+    template<typename K>
+    size_t find(const Node* nodes, size_t keys_count, const K& val, size_t h) const {
+        for (size_t i = 0; i < keys_count; i++) {
+            size_t idx = probe(h, i, keys_count);
+            if (nodes[idx].is_empty == true) {
+                return npos;
+            }
+            if (same_key(nodes[idx], val, h)) {
+                return idx;
+            }
+        }
+        return npos;
+    }
+
+    // Первый пустой или удалённый слот на пути пробирования
+    size_t free_slot(const Node* nodes, size_t keys_count, size_t h) const {
+        for (size_t i = 0; i < keys_count; i++) {
+            size_t idx = probe(h, i, keys_count);
+            if (nodes[idx].is_empty == true || nodes[idx].is_deleted == true) {
+                return idx;
             }
-            i++;
-            idx = hash(val, i);
         }
-        if (table[idx].is_empty == false) {
-            grow();
-            return push(val);
+        return npos;
+    }
+
+    // Занимает слот новой таблицы, учитывая переиспользованное надгробие
+    void place(size_t idx, typename Keys::Key&& key, size_t h) {
+        if (table[idx].is_deleted == true) {
+            deleted_count--;
         }
-        
-        
-        table[idx].val = val;
-        table[idx].is_empty = false;
+        // Ключ пишется раньше флагов: читатель без замка не увидит живой слот со старым ключом
+        shared_store(table[idx].val, std::move(key));
+        shared_store(table[idx].hash, h);
+        shared_store(table[idx].is_deleted, false);
+        shared_store(table[idx].is_empty, false);
+    }
+
+    // Новый размер может совпадать со старым - тогда перестроение только вычищает надгробия
+    void resize(size_t new_max_keys_count) {
+        if (old_table) {
+            // Предыдущий перенос ещё не закончен
+            finish_rehash();
+        }
+        old_table = table;
+        old_max_keys_count = max_keys_count;
+        rehash_pos = 0;
+
+        max_keys_count = new_max_keys_count;
+        table = new Node[max_keys_count];
+        deleted_count = 0;
+        if (!config.incremental_rehash) {
+            finish_rehash();
+        }
+    }
+
+    void migrate_step() {
+        if (old_table) {
+            migrate(config.rehash_step);
+        }
+    }
+
+    void finish_rehash() {
+        if (old_table) {
+            migrate(old_max_keys_count);
+        }
+    }
+
+    // Переносит живые ключи из следующих slots_count слотов старой таблицы
+    void migrate(size_t slots_count) {
+        size_t end = std::min(rehash_pos + slots_count, old_max_keys_count);
+        for (; rehash_pos < end; rehash_pos++) {
+            Node& node = old_table[rehash_pos];
+            if (node.is_empty == false && node.is_deleted == false) {
+                place(free_slot(table, max_keys_count, node.hash), std::move(node.val), node.hash);
+                // Перенесённый слот не должен находиться поиском по старой таблице
+                shared_store(node.is_deleted, true);
+            }
+        }
+
+        if (rehash_pos == old_max_keys_count) {
+            free_table(old_table);
+            old_table = nullptr;
+            old_max_keys_count = 0;
+        }
+    }
+
+    // Таблица, которую может читать ConcurrentHashTable без замка, освобождается позже
+    void free_table(Node* nodes) {
+        if (retired) {
+            retired->emplace_back(nodes, [](void* dead) { delete [] static_cast<Node*>(dead); });
+        } else {
+            delete [] nodes;
+        }
+    }
+
+    void defer_frees(std::vector<std::shared_ptr<void>>* retired_list) {
+        retired = retired_list;
+        keys.defer_frees(retired_list);
+    }
+
+    void compact_keys() {
+        keys.compact([this](auto visit) {
+            for (Node* nodes : {old_table, table}) {
+                size_t keys_count = (nodes == table) ? max_keys_count : old_max_keys_count;
+                for (size_t i = 0; i < keys_count; i++) {
+                    if (nodes[i].is_empty == false && nodes[i].is_deleted == false) {
+                        visit(nodes[i].val);
+                    }
+                }
+            }
+        });
+    }
+
+    static constexpr double fill_rate = 0.75;
+
+    Hash hash;
+    Comp comp;
+    HashTableConfig config;
+    Keys keys;
+
+    size_t items_count = 0;
+    size_t deleted_count = 0;   // Надгробия в текущей таблице, живые ключи в них не входят
+    size_t max_keys_count;
+
+    Node* table;
+
+    // Старая таблица существует только во время постепенного переноса
+    Node* old_table = nullptr;
+    size_t old_max_keys_count = 0;
+    size_t rehash_pos = 0;
+
+    std::vector<std::shared_ptr<void>>* retired = nullptr;
+};
+
+
+/************ Группы контрольных меток ************/
+
+static constexpr int8_t ctrl_empty = -128;
+static constexpr int8_t ctrl_deleted = -2;
+
+static inline int8_t ctrl_tag(size_t h) {
+    return static_cast<int8_t>(h & 0x7F);
+}
+
+static inline size_t ctrl_home_group(size_t h) {
+    return h >> 7;
+}
+
+struct CtrlGroup {
+    static constexpr size_t width = 16;
+
+#if defined(__SSE2__)
+    explicit CtrlGroup(const int8_t* pos)
+    :
+    ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) {}
+
+    uint32_t match(int8_t tag) const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), ctrl)));
+    }
+
+    // Пустые и удалённые метки отрицательны
+    uint32_t match_free() const {
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+    }
+
+    __m128i ctrl;
+#else
+    explicit CtrlGroup(const int8_t* pos) : ctrl(pos) {}
+
+    uint32_t match(int8_t tag) const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; i++) {
+            mask |= static_cast<uint32_t>(ctrl[i] == tag) << i;
+        }
+        return mask;
+    }
+
+    uint32_t match_free() const {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; i++) {
+            mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+        }
+        return mask;
+    }
+
+    const int8_t* ctrl;
+#endif
+
+    uint32_t match_empty() const {
+        return match(ctrl_empty);
+    }
+};
+
+// Обходит группы в порядке пробирования, is_match проверяет слоты с совпавшей меткой.
+// Каждая группа посещается не больше раза, так что и без пустых меток обход конечен
+template<typename IsMatch>
+size_t probe_groups(const int8_t* ctrl, size_t groups_count, size_t h, IsMatch is_match) {
+    size_t mask = groups_count - 1;
+    size_t group_idx = ctrl_home_group(h) & mask;
+    for (size_t step = 1; step <= groups_count; step++) {
+        CtrlGroup group(ctrl + group_idx * CtrlGroup::width);
+        for (uint32_t match = group.match(ctrl_tag(h)); match; match &= match - 1) {
+            size_t idx = group_idx * CtrlGroup::width + __builtin_ctz(match);
+            if (is_match(idx)) {
+                return idx;
+            }
+        }
+        if (group.match_empty()) {
+            return static_cast<size_t>(-1);
+        }
+        // Треугольные шаги обходят все группы при их числе 2^k
+        group_idx = (group_idx + step) & mask;
+    }
+    return static_cast<size_t>(-1);
+}
+
+
+/************ Снимок таблицы на диске ************/
+
+static constexpr char snapshot_magic[8] = {'F', 'L', 'A', 'T', 'S', 'N', 'A', 'P'};
+static constexpr uint32_t snapshot_version = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t group_width;
+    uint64_t groups_count;
+    uint64_t items_count;
+    uint64_t arena_size;
+    uint64_t hash_check;    // Хеш magic: снимок читается только той же хеш-функцией
+    uint64_t checksum;
+    uint64_t reserved;
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout");
+
+struct SnapshotSlot {
+    uint64_t hash = 0;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+static_assert(sizeof(SnapshotSlot) == 16, "snapshot slot layout");
+
+// Контрольная сумма секций: каждая хешируется с seed, равным сумме предыдущих
+static inline uint64_t snapshot_checksum(std::string_view ctrl, std::string_view slots, std::string_view arena) {
+    uint64_t checksum = Hash<std::string>(snapshot_version)(ctrl);
+    checksum = Hash<std::string>(checksum)(slots);
+    return Hash<std::string>(checksum)(arena);
+}
+
+
+/*
+ * Таблица только для чтения поверх отображённого в память снимка
+ * FlatHashTable: поиск идёт прямо по страницам файла без разбора,
+ * страницы кэша делятся между процессами.
+ */
+template<
+    typename Hash = Hash<std::string>,
+    typename Comp = Comp<std::string>
+>
+class MappedHashTable {
+  public:
+    explicit MappedHashTable(Hash hash = Hash(), Comp comp = Comp())
+    :
+    hash(hash),
+    comp(comp) {}
+
+    MappedHashTable(const MappedHashTable&) = delete;
+    MappedHashTable& operator=(const MappedHashTable&) = delete;
+
+    MappedHashTable(MappedHashTable&& other)
+    :
+    hash(other.hash),
+    comp(other.comp),
+    data(other.data),
+    data_size(other.data_size),
+    header(other.header),
+    ctrl(other.ctrl),
+    slots(other.slots),
+    arena(other.arena) {
+        other.data = nullptr;
+        other.data_size = 0;
+        other.header = nullptr;
+    }
+
+    MappedHashTable& operator=(MappedHashTable&&) = delete;
+
+    ~MappedHashTable() {
+        close();
+    }
+
+    bool open(const char* path, bool verify_checksum = false) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            return false;
+        }
+        data_size = static_cast<size_t>(info.st_size);
+        void* mapped = ::mmap(nullptr, data_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            data_size = 0;
+            return false;
+        }
+        data = static_cast<const char*>(mapped);
+
+        if (!attach(verify_checksum)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) {
+            ::munmap(const_cast<char*>(data), data_size);
+        }
+        data = nullptr;
+        data_size = 0;
+        header = nullptr;
+    }
+
+    bool is_open() const {
+        return header != nullptr;
+    }
+
+    size_t size() const {
+        return header ? header->items_count : 0;
+    }
+
+    template<typename K>
+    bool in_table(const K& val) const {
+        if (!header) {
+            return false;
+        }
+        size_t h = hash(val);
+        return probe_groups(ctrl, header->groups_count, h, [&](size_t idx) {
+            const SnapshotSlot& slot = slots[idx];
+            return slot.hash == h &&
+                   static_cast<size_t>(slot.offset) + slot.length <= header->arena_size &&
+                   comp(std::string_view(arena + slot.offset, slot.length), val);
+        }) != static_cast<size_t>(-1);
+    }
+
+  private:
+    // Проверяет заголовок и размеры секций, затем раскладывает указатели по файлу
+    bool attach(bool verify_checksum) {
+        const SnapshotHeader* candidate = reinterpret_cast<const SnapshotHeader*>(data);
+        if (std::memcmp(candidate->magic, snapshot_magic, sizeof(candidate->magic)) != 0 ||
+            candidate->version != snapshot_version ||
+            candidate->group_width != CtrlGroup::width ||
+            candidate->groups_count == 0 ||
+            (candidate->groups_count & (candidate->groups_count - 1)) != 0 ||
+            candidate->hash_check != hash(std::string_view(snapshot_magic, sizeof(snapshot_magic)))) {
+            return false;
+        }
+
+        // Поля заголовка не доверенные: сначала ограничиваем groups_count размером
+        // файла, и только потом умножаем, чтобы произведения не переполнились
+        size_t payload = data_size - sizeof(SnapshotHeader);
+        size_t group_bytes = CtrlGroup::width * (1 + sizeof(SnapshotSlot));
+        if (candidate->groups_count > payload / group_bytes) {
+            return false;
+        }
+        size_t capacity = candidate->groups_count * CtrlGroup::width;
+        if (candidate->arena_size != payload - candidate->groups_count * group_bytes) {
+            return false;
+        }
+
+        const char* ctrl_data = data + sizeof(SnapshotHeader);
+        if (!has_empty_slot(reinterpret_cast<const int8_t*>(ctrl_data), candidate->groups_count)) {
+            return false;
+        }
+        const char* slots_data = ctrl_data + capacity;
+        const char* arena_data = slots_data + capacity * sizeof(SnapshotSlot);
+        if (verify_checksum &&
+            candidate->checksum != snapshot_checksum(
+                std::string_view(ctrl_data, capacity),
+                std::string_view(slots_data, capacity * sizeof(SnapshotSlot)),
+                std::string_view(arena_data, candidate->arena_size))) {
+            return false;
+        }
+
+        header = candidate;
+        ctrl = reinterpret_cast<const int8_t*>(ctrl_data);
+        slots = reinterpret_cast<const SnapshotSlot*>(slots_data);
+        arena = arena_data;
+        return true;
+    }
+
+    // Таблица всегда оставляет пустые слоты, иначе снимок испорчен. Обычно
+    // пустая метка находится в первой же группе
+    static bool has_empty_slot(const int8_t* ctrl, size_t groups_count) {
+        for (size_t group_idx = 0; group_idx < groups_count; group_idx++) {
+            if (CtrlGroup(ctrl + group_idx * CtrlGroup::width).match_empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Hash hash;
+    Comp comp;
+
+    const char* data = nullptr;
+    size_t data_size = 0;
+
+    const SnapshotHeader* header = nullptr;
+    const int8_t* ctrl = nullptr;
+    const SnapshotSlot* slots = nullptr;
+    const char* arena = nullptr;
+};
+
+
+/*
+ * Таблица с раздельным хранением: массив однобайтовых контрольных меток
+ * (пусто / удалено / младшие 7 бит хеша) и массив ключей.
+ * Пробирование идёт группами по 16 меток, ключ читается только
+ * при совпадении метки.
+ */
+template<
+    typename Value,
+    typename Hash = Hash<Value>,
+    typename Comp = Comp<Value>
+>
+class FlatHashTable {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+  public:
+    FlatHashTable(Hash hash = Hash(), Comp comp = Comp())
+    :
+    hash(hash),
+    comp(comp),
+    groups_count(1) {
+        allocate(groups_count);
+    }
+
+    FlatHashTable(const FlatHashTable&) = delete;
+    FlatHashTable(FlatHashTable&&) = delete;
+    FlatHashTable& operator=(const FlatHashTable&) = delete;
+    FlatHashTable& operator=(FlatHashTable&&) = delete;
+
+    ~FlatHashTable() {
+        delete [] ctrl;
+        delete [] slots;
+    }
+
+    bool is_empty() const {
+        return items_count == 0;
+    }
+
+    size_t size() const {
+        return items_count;
+    }
+
+    bool in_table(const Value& val) {
+        return find(val, hash(val)) != npos;
+    }
+
+    ssize_t push(const Value& val) {
+        size_t h = hash(val);
+        if (find(val, h) != npos) {
+            return ALREADY_EXIST;
+        }
+        if (items_count + deleted_count >= capacity() * fill_rate) {
+            // Если большая часть занятых слотов - надгробия, хватит перестроения
+            rehash(deleted_count * 2 >= items_count ? groups_count : groups_count * 2);
+        }
+
+        size_t idx = find_free(h);
+        if (ctrl[idx] == ctrl_deleted) {
+            deleted_count--;
+        }
+        ctrl[idx] = ctrl_tag(h);
+        slots[idx] = val;
         items_count++;
         return 0;
     }
 
-    ssize_t pop(Value& val) {
-        for (size_t i = 0; i < max_keys_count; i++) {
-            size_t idx = hash(val, i);
-            if (table[idx].is_empty == false) {
-                if (table[idx].val == val && table[idx].is_deleted == false) {
-                    table[idx].is_deleted = true;
+    ssize_t pop(const Value& val) {
+        size_t idx = find(val, hash(val));
+        if (idx == npos) {
+            return NOT_EXIST;
+        }
+        ctrl[idx] = ctrl_deleted;
+        slots[idx] = Value();
+        items_count--;
+        deleted_count++;
+        return 0;
+    }
 
-                    items_count--;
-                    return 0;
+    // Снимок: заголовок, контрольные метки, слоты (хеш, смещение, длина) и арена байтов ключей
+    bool save(const char* path) const {
+        std::vector<SnapshotSlot> file_slots(capacity());
+        std::vector<char> arena;
+        for (size_t i = 0; i < capacity(); i++) {
+            if (ctrl[i] >= 0) {
+                std::string_view key(slots[i]);
+                if (arena.size() + key.size() > UINT32_MAX) {
+                    return false;
                 }
-            } else {
-                return NOT_EXIST;
+                file_slots[i].hash = hash(key);
+                file_slots[i].offset = static_cast<uint32_t>(arena.size());
+                file_slots[i].length = static_cast<uint32_t>(key.size());
+                arena.insert(arena.end(), key.begin(), key.end());
             }
         }
-        return NOT_EXIST;
+
+        SnapshotHeader header = {};
+        std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+        header.version = snapshot_version;
+        header.group_width = CtrlGroup::width;
+        header.groups_count = groups_count;
+        header.items_count = items_count;
+        header.arena_size = arena.size();
+        header.hash_check = hash(std::string_view(snapshot_magic, sizeof(header.magic)));
+        header.checksum = snapshot_checksum(
+            std::string_view(reinterpret_cast<const char*>(ctrl), capacity()),
+            std::string_view(reinterpret_cast<const char*>(file_slots.data()), file_slots.size() * sizeof(SnapshotSlot)),
+            std::string_view(arena.data(), arena.size()));
+
+        FILE* file = std::fopen(path, "wb");
+        if (!file) {
+            return false;
+        }
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                  std::fwrite(ctrl, 1, capacity(), file) == capacity() &&
+                  std::fwrite(file_slots.data(), sizeof(SnapshotSlot), file_slots.size(), file) == file_slots.size() &&
+                  std::fwrite(arena.data(), 1, arena.size(), file) == arena.size();
+        return std::fclose(file) == 0 && ok;
+    }
+
+    // Таблица только для чтения поверх отображённого снимка; проверить is_open()
+    static MappedHashTable<Hash, Comp> open_mmap(const char* path, bool verify_checksum = false,
+                                                 Hash hash = Hash(), Comp comp = Comp()) {
+        MappedHashTable<Hash, Comp> mapped(hash, comp);
+        mapped.open(path, verify_checksum);
+        return mapped;
     }
 
   private:
-    size_t hash(Value& val, size_t i) {
-        return((hash1(val, max_keys_count) + i * hash2(val, max_keys_count)) % max_keys_count);
-    }
-      
-    void grow() {
-        size_t old_max_keys_count = max_keys_count;
-        max_keys_count = 2 * old_max_keys_count;
-        
-        Node* new_table = new Node[max_keys_count];
-        for (size_t i = 0; i < old_max_keys_count; i++) {
-                                                                                    
-            if (table[i].is_empty == false && table[i].is_deleted == false) {
-                size_t j = 0;
-
-                size_t idx = hash(table[i].val, j);
-                while (j < max_keys_count) {
-                    if (new_table[idx].is_empty == true) {
-                        break;
-                    }
-                    j++;
-                    idx = hash(table[i].val, j);
-                }
-                new_table[idx].val = table[i].val;
-                new_table[idx].is_empty = false;
+    size_t capacity() const {
+        return groups_count * CtrlGroup::width;
+    }
+
+    size_t find(const Value& val, size_t h) {
+        return probe_groups(ctrl, groups_count, h, [&](size_t idx) {
+            return comp(slots[idx], val);
+        });
+    }
+
+    size_t find_free(size_t h) {
+        size_t mask = groups_count - 1;
+        size_t group_idx = ctrl_home_group(h) & mask;
+        for (size_t step = 1; ; step++) {
+            uint32_t free = CtrlGroup(ctrl + group_idx * CtrlGroup::width).match_free();
+            if (free) {
+                return group_idx * CtrlGroup::width + __builtin_ctz(free);
             }
+            group_idx = (group_idx + step) & mask;
         }
+    }
 
-        delete [] table;
-        table = new_table;
+    void allocate(size_t new_groups_count) {
+        groups_count = new_groups_count;
+        ctrl = new int8_t[capacity()];
+        std::fill(ctrl, ctrl + capacity(), ctrl_empty);
+        slots = new Value[capacity()];
     }
 
-    static constexpr double fill_rate = 0.75;
+    void rehash(size_t new_groups_count) {
+        size_t old_capacity = capacity();
+        int8_t* old_ctrl = ctrl;
+        Value* old_slots = slots;
+
+        allocate(new_groups_count);
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_ctrl[i] >= 0) {
+                size_t h = hash(old_slots[i]);
+                size_t idx = find_free(h);
+                ctrl[idx] = ctrl_tag(h);
+                slots[idx] = std::move(old_slots[i]);
+            }
+        }
+        deleted_count = 0;
 
-    Hash1 hash1;
-    Hash2 hash2;
+        delete [] old_ctrl;
+        delete [] old_slots;
+    }
+
+    static constexpr double fill_rate = 0.875;
+
+    Hash hash;
     Comp comp;
 
     size_t items_count = 0;
-    size_t max_keys_count;
+    size_t deleted_count = 0;
+    size_t groups_count;
 
-    Node* table;
+    int8_t* ctrl;
+    Value* slots;
+};
+
+
+// Хранение ключей по умолчанию для ConcurrentHashTable: строки читаются
+// без замка только из арены, inline std::string освобождается сразу
+template<typename Value>
+struct ConcurrentKeys {
+    using type = InlineKeys<Value>;
+};
+
+template<>
+struct ConcurrentKeys<std::string> {
+    using type = ArenaKeys;
+};
+
+
+/*
+ * Потокобезопасная таблица: ключи разбиты на шарды по старшим битам хеша,
+ * каждый шард - отдельная HashTable с замком писателей и независимым ростом.
+ *
+ * Читатели не берут замков и не пишут в общую память шарда (seqlock):
+ * писатель делает счётчик версии нечётным на время изменения, читатель
+ * пробирует слоты атомарными загрузками и повторяет поиск, если версия
+ * сменилась. Указатели на таблицы и буфер ключей читатель берёт из
+ * неизменяемого описания шарда, которое писатель заменяет целиком.
+ *
+ * Старые таблицы, буферы арены и описания освобождаются по эпохам: читатель
+ * на время поиска объявляет текущую эпоху в своей строке, писатель отдаёт
+ * память, только когда все объявленные эпохи новее момента её снятия.
+ */
+template<
+    typename Value,
+    typename Hash = Hash<Value>,
+    typename Comp = Comp<Value>,
+    typename Keys = typename ConcurrentKeys<Value>::type
+>
+class ConcurrentHashTable {
+    using Table = HashTable<Value, Hash, Comp, Keys>;
+    using Node = typename Table::Node;
+
+    static_assert(Keys::optimistic_reads, "keys must be readable without a lock (use ArenaKeys for strings)");
+
+    // Всё, что нужно читателю, чтобы пройти по таблицам шарда
+    struct Layout {
+        const Node* table = nullptr;
+        size_t keys_count = 0;
+        const Node* old_table = nullptr;
+        size_t old_keys_count = 0;
+        typename Keys::Snapshot keys;
+    };
+
+    // Шарды выровнены по кэш-линии, чтобы счётчики соседей не делили строку
+    struct alignas(64) Shard {
+        Shard(Hash hash, Comp comp, HashTableConfig config) : table(hash, comp, config) {}
+
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<const Layout*> layout{nullptr};
+        std::atomic<size_t> items_count{0};
+
+        std::mutex lock;
+        Table table;
+        std::vector<std::shared_ptr<void>> retired_now;  // Снятое текущей операцией
+        RetireList retired;
+    };
+
+  public:
+    explicit ConcurrentHashTable(size_t min_shards_count = 64, Hash hash = Hash(), Comp comp = Comp(),
+                                 HashTableConfig config = HashTableConfig())
+    :
+    hash(hash),
+    comp(comp) {
+        while ((static_cast<size_t>(1) << shards_log) < min_shards_count) {
+            shards_log++;
+        }
+        for (size_t i = 0; i < (static_cast<size_t>(1) << shards_log); i++) {
+            shards.emplace_back(new Shard(hash, comp, config));
+            Shard& shard = *shards.back();
+            shard.table.defer_frees(&shard.retired_now);
+            shard.layout.store(new Layout(layout_of(shard.table)), std::memory_order_release);
+        }
+    }
+
+    ~ConcurrentHashTable() {
+        for (auto& shard : shards) {
+            delete shard->layout.load();
+        }
+    }
+
+    ConcurrentHashTable(const ConcurrentHashTable&) = delete;
+    ConcurrentHashTable(ConcurrentHashTable&&) = delete;
+    ConcurrentHashTable& operator=(const ConcurrentHashTable&) = delete;
+    ConcurrentHashTable& operator=(ConcurrentHashTable&&) = delete;
+
+    size_t size() const {
+        size_t items_count = 0;
+        for (auto& shard : shards) {
+            items_count += shard->items_count.load(std::memory_order_relaxed);
+        }
+        return items_count;
+    }
+
+    template<typename K>
+    bool in_table(const K& val) const {
+        size_t h = hash(val);
+        Shard& shard = shard_for(h);
+        size_t slot = epochs.enter();
+        if (slot == ReaderSlots::none) {
+            std::lock_guard<std::mutex> guard(shard.lock);
+            return shard.table.contains_hashed(val, h);
+        }
+
+        bool found = false;
+        while (true) {
+            uint64_t version = shard.sequence.load(std::memory_order_acquire);
+            if (version & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            const Layout* layout = shard.layout.load(std::memory_order_acquire);
+            found = find(*layout, layout->old_table, layout->old_keys_count, val, h) ||
+                    find(*layout, layout->table, layout->keys_count, val, h);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shard.sequence.load(std::memory_order_relaxed) == version) {
+                break;
+            }
+        }
+        epochs.leave(slot);
+        return found;
+    }
+
+    template<typename K>
+    ssize_t push(const K& val) {
+        size_t h = hash(val);
+        return write(shard_for(h), [&](Table& table) {
+            table.migrate_step();
+            return table.push_hashed(val, h);
+        });
+    }
+
+    template<typename K>
+    ssize_t pop(const K& val) {
+        size_t h = hash(val);
+        return write(shard_for(h), [&](Table& table) {
+            table.migrate_step();
+            return table.pop_hashed(val, h);
+        });
+    }
+
+  private:
+    static Layout layout_of(const Table& table) {
+        Layout layout;
+        layout.table = table.table;
+        layout.keys_count = table.max_keys_count;
+        layout.old_table = table.old_table;
+        layout.old_keys_count = table.old_max_keys_count;
+        layout.keys = table.keys.snapshot();
+        return layout;
+    }
+
+    // Разорванное чтение даёт мусорный ответ, но не выходит за живую память;
+    // ответ всё равно отбрасывается проверкой версии
+    template<typename K>
+    bool find(const Layout& layout, const Node* nodes, size_t keys_count, const K& val, size_t h) const {
+        for (size_t i = 0; i < keys_count; i++) {
+            const Node& node = nodes[Table::probe(h, i, keys_count)];
+            if (shared_load(node.is_empty)) {
+                return false;
+            }
+            if (shared_load(node.hash) == h && !shared_load(node.is_deleted) &&
+                comp(Keys::view_in(layout.keys, shared_load(node.val)), val)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename Operation>
+    ssize_t write(Shard& shard, Operation operation) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        uint64_t version = shard.sequence.load(std::memory_order_relaxed);
+        shard.sequence.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        ssize_t result = operation(shard.table);
+
+        const Layout* current = shard.layout.load(std::memory_order_relaxed);
+        Layout fresh = layout_of(shard.table);
+        bool layout_changed = fresh.table != current->table || fresh.keys_count != current->keys_count ||
+                              fresh.old_table != current->old_table || fresh.keys != current->keys;
+        if (layout_changed) {
+            shard.layout.store(new Layout(fresh), std::memory_order_release);
+            shard.retired_now.emplace_back(const_cast<Layout*>(current),
+                                           [](void* dead) { delete static_cast<Layout*>(dead); });
+        }
+        shard.items_count.store(shard.table.size(), std::memory_order_relaxed);
+        shard.sequence.store(version + 2, std::memory_order_release);
+
+        if (!shard.retired_now.empty()) {
+            uint64_t retired_epoch = epochs.advance();
+            for (auto& memory : shard.retired_now) {
+                shard.retired.retire(retired_epoch, std::move(memory));
+            }
+            shard.retired_now.clear();
+        }
+        if (!shard.retired.empty()) {
+            shard.retired.reclaim(epochs);
+        }
+        return result;
+    }
+
+    // Младшие биты хеша задают слот внутри шарда, поэтому шард берётся по старшим
+    Shard& shard_for(size_t h) const {
+        return *shards[shards_log == 0 ? 0 : h >> (64 - shards_log)];
+    }
+
+    Hash hash;
+    Comp comp;
+    size_t shards_log = 0;
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    EpochDomain epochs;
+};
+
+
+/*********** Буферизованный ввод-вывод ***********/
+
+// Читает вход крупными блоками и выдаёт слова прямо из буфера
+class TokenReader {
+  public:
+    explicit TokenReader(FILE* input, size_t block_size = 1 << 20)
+    :
+    input(input),
+    buffer(block_size) {}
+
+    // Представление слова действительно до следующего вызова next
+    bool next(std::string_view& token) {
+        while (true) {
+            while (pos < end && is_space(buffer[pos])) {
+                pos++;
+            }
+            if (pos == end) {
+                if (!refill()) {
+                    return false;
+                }
+                continue;
+            }
+
+            size_t start = pos;
+            while (pos < end && !is_space(buffer[pos])) {
+                pos++;
+            }
+            if (pos < end || eof) {
+                token = std::string_view(buffer.data() + start, pos - start);
+                return true;
+            }
+            // Слово обрезано краем блока: дочитываем и разбираем его заново
+            pos = start;
+            refill();
+        }
+    }
+
+  private:
+    static bool is_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    bool refill() {
+        if (eof) {
+            return false;
+        }
+        std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+        end -= pos;
+        pos = 0;
+        if (end == buffer.size()) {
+            buffer.resize(2 * buffer.size());
+        }
+
+        size_t read = std::fread(buffer.data() + end, 1, buffer.size() - end, input);
+        if (read == 0) {
+            eof = true;
+        }
+        end += read;
+        return read > 0;
+    }
+
+    FILE* input;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+
+// Копит ответы и пишет их крупными блоками
+class OutputBuffer {
+  public:
+    explicit OutputBuffer(FILE* output, size_t block_size = 1 << 20)
+    :
+    output(output),
+    block_size(block_size) {
+        buffer.reserve(block_size);
+    }
+
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    ~OutputBuffer() {
+        flush();
+    }
+
+    void write(std::string_view text) {
+        if (buffer.size() + text.size() > block_size) {
+            flush();
+        }
+        buffer.append(text);
+    }
+
+    void flush() {
+        std::fwrite(buffer.data(), 1, buffer.size(), output);
+        std::fflush(output);
+        buffer.clear();
+    }
+
+  private:
+    FILE* output;
+    size_t block_size;
+    std::string buffer;
 };
 
 
 int main() {
     HashTable<std::string> hash_table;
-    std::string operation;
-    std::string text;
-    while (std::cin >> operation >> text) {
+    TokenReader reader(stdin);
+    OutputBuffer writer(stdout);
+
+    std::string_view token;
+    while (reader.next(token)) {
+        char operation = (token.size() == 1) ? token[0] : '\0';
+        std::string_view text;
+        if (!reader.next(text)) {
+            break;
+        }
+
         ssize_t error = -1;
-        if (operation == "+") {
+        if (operation == '+') {
             error = hash_table.push(text);
-        } else if (operation == "-") {
+        } else if (operation == '-') {
             error = hash_table.pop(text);
-        } else if (operation == "?") {
+        } else if (operation == '?') {
             bool exist = hash_table.in_table(text);
             if (exist) {
                 error = 0;
@@ -209,9 +1545,9 @@ int main() {
         }
 
         if (error) {
-            std::cout << "FAIL" << std::endl;
+            writer.write("FAIL\n");
         } else {
-            std::cout << "OK" << std::endl;
+            writer.write("OK\n");
         }
     }
     return 0;
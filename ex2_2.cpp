@@ -1,18 +1,376 @@
 #include <iostream>
 #include <stack>
 #include <algorithm>
+#include <vector>
+#include <new>
+#include <type_traits>
+#include <thread>
+#include <iterator>
+#include <string>
+#include <sstream>
+#include <charconv>
 
+#include "fast_io.h"
 
+
+/************ Параллельная сортировка **************/
+
+static const size_t parallel_sort_threshold = 1 << 20;
+
+// Куски сортируются в отдельных потоках, затем сливаются попарно
 template<typename Value>
+void parallel_sort(std::vector<Value>& values) {
+    size_t threads_count = std::thread::hardware_concurrency();
+    if (values.size() < parallel_sort_threshold || threads_count < 2) {
+        std::sort(values.begin(), values.end());
+        return;
+    }
+
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= threads_count; i++) {
+        bounds.push_back(values.size() * i / threads_count);
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads_count; i++) {
+        workers.emplace_back([&values, &bounds, i] {
+            std::sort(values.begin() + bounds[i], values.begin() + bounds[i + 1]);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t width = 1; width < threads_count; width *= 2) {
+        workers.clear();
+        for (size_t i = 0; i + width < threads_count; i += 2 * width) {
+            size_t begin = bounds[i];
+            size_t middle = bounds[i + width];
+            size_t end = bounds[std::min(i + 2 * width, threads_count)];
+            workers.emplace_back([&values, begin, middle, end] {
+                std::inplace_merge(values.begin() + begin, values.begin() + middle, values.begin() + end);
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+}
+
+
+/************ Статическое дерево **************/
+
+/*
+ * Неизменяемое дерево в порядке Эйтцингера: узел k хранит детей
+ * в 2k и 2k + 1, указателей нет, верхние уровни лежат в одних
+ * кэш-линиях. Поиск без ветвлений с упреждающей загрузкой.
+ */
+template<typename Value>
+class FrozenTree {
+  public:
+    class const_iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        const_iterator(const FrozenTree* tree, size_t idx) : tree(tree), idx(idx) {}
+
+        reference operator*() const {
+            return tree->data[idx];
+        }
+
+        pointer operator->() const {
+            return &tree->data[idx];
+        }
+
+        const_iterator& operator++() {
+            idx = tree->next(idx);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return idx == other.idx;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return idx != other.idx;
+        }
+
+      private:
+        const FrozenTree* tree;
+        size_t idx;
+    };
+
+    FrozenTree() = default;
+
+    // sorted - ключи в порядке возрастания
+    explicit FrozenTree(const std::vector<Value>& sorted)
+    :
+    data(sorted.size() + 1) {
+        fill(sorted, 0, 1);
+    }
+
+    size_t size() const {
+        return data.size() - 1;
+    }
+
+    const_iterator begin() const {
+        size_t idx = 1;
+        while (2 * idx <= size()) {
+            idx *= 2;
+        }
+        return const_iterator(this, size() ? idx : 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, 0);
+    }
+
+    // Первый ключ не меньше val
+    const_iterator lower_bound(const Value& val) const {
+        size_t n = size();
+        size_t idx = 1;
+        while (idx <= n) {
+            __builtin_prefetch(data.data() + std::min(idx * prefetch_distance, n));
+            idx = 2 * idx + (data[idx] < val);
+        }
+        // Снимаем повороты направо, сделанные после последнего шага влево
+        idx >>= __builtin_ffsll(~static_cast<long long>(idx));
+        return const_iterator(this, idx);
+    }
+
+    bool contains(const Value& val) const {
+        const_iterator it = lower_bound(val);
+        return it != end() && !(val < *it);
+    }
+
+  private:
+    // Через столько уровней потомки узла занимают одну кэш-линию
+    static constexpr size_t prefetch_distance = 64 / sizeof(Value) > 1 ? 64 / sizeof(Value) : 2;
+
+    size_t fill(const std::vector<Value>& sorted, size_t pos, size_t idx) {
+        if (idx < data.size()) {
+            pos = fill(sorted, pos, 2 * idx);
+            data[idx] = sorted[pos++];
+            pos = fill(sorted, pos, 2 * idx + 1);
+        }
+        return pos;
+    }
+
+    // Следующий по порядку узел, 0 после последнего
+    size_t next(size_t idx) const {
+        if (2 * idx + 1 <= size()) {
+            idx = 2 * idx + 1;
+            while (2 * idx <= size()) {
+                idx *= 2;
+            }
+            return idx;
+        }
+        while (idx & 1) {
+            idx >>= 1;
+        }
+        return idx >> 1;
+    }
+
+    std::vector<Value> data = std::vector<Value>(1);    // data[0] не используется
+};
+
+
+/************ Политики балансировки **************/
+
+// Дерево растёт как есть, высота зависит от порядка вставки
+struct NoBalancing {
+    static constexpr bool enabled = false;
+};
+
+// AVL-повороты по уже хранимым высотам, высота O(log n)
+struct AVLBalancing {
+    static constexpr bool enabled = true;
+};
+
+
+/************ Распределители узлов **************/
+
+// Узлы нарезаются из крупных блоков, память возвращается целыми блоками
+template<typename T>
+class SlabPool {
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+  public:
+    // Деструктор пула освобождает все узлы разом
+    static constexpr bool releases_all = true;
+
+    SlabPool() = default;
+    ~SlabPool() {
+        for (Slot* block : blocks) {
+            ::operator delete(block);
+        }
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    T* create() {
+        Slot* slot = free_list;
+        if (slot) {
+            free_list = slot->next;
+        } else {
+            if (used == block_size) {
+                // Блоки растут вдвое, чтобы число выделений было логарифмическим
+                block_size = blocks.empty() ? min_block_size : std::min(2 * block_size, max_block_size);
+                blocks.push_back(static_cast<Slot*>(::operator new(block_size * sizeof(Slot))));
+                used = 0;
+            }
+            slot = blocks.back() + used++;
+        }
+        return new (slot->storage) T();
+    }
+
+    void destroy(T* node) {
+        node->~T();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = free_list;
+        free_list = slot;
+    }
+
+  private:
+    static constexpr size_t min_block_size = 64;
+    static constexpr size_t max_block_size = 1 << 16;
+
+    std::vector<Slot*> blocks;
+    size_t block_size = 0;
+    size_t used = 0;
+    Slot* free_list = nullptr;
+};
+
+// Каждый узел выделяется отдельно через new
+template<typename T>
+class HeapAllocator {
+  public:
+    static constexpr bool releases_all = false;
+
+    T* create() {
+        return new T();
+    }
+
+    void destroy(T* node) {
+        delete node;
+    }
+};
+
+
+template<
+    typename Value,
+    template<typename> class Allocator = SlabPool,
+    typename Balancing = NoBalancing
+>
 class BinaryTree {
     struct Node {
         Value key;
         size_t height = 1;
         Node* left = nullptr;
         Node* right = nullptr;
+        Node* parent = nullptr;
     };
     
   public:
+    // Обход по порядку через ссылки на родителя, без стека
+    class const_iterator {
+      public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Value*;
+        using reference = const Value&;
+
+        const_iterator(const BinaryTree* tree, Node* node) : tree(tree), node(node) {}
+
+        reference operator*() const {
+            return node->key;
+        }
+
+        pointer operator->() const {
+            return &node->key;
+        }
+
+        const_iterator& operator++() {
+            if (node->right) {
+                node = leftmost(node->right);
+            } else {
+                while (node->parent && node->parent->right == node) {
+                    node = node->parent;
+                }
+                node = node->parent;
+            }
+            return *this;
+        }
+
+        // end() шагает назад к последнему ключу
+        const_iterator& operator--() {
+            if (!node) {
+                node = rightmost(tree->root);
+            } else if (node->left) {
+                node = rightmost(node->left);
+            } else {
+                while (node->parent && node->parent->left == node) {
+                    node = node->parent;
+                }
+                node = node->parent;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        const_iterator operator--(int) {
+            const_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return node == other.node;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return node != other.node;
+        }
+
+      private:
+        const BinaryTree* tree;
+        Node* node;
+    };
+
+    // Полуинтервал итераторов, пригодный для range-based for
+    struct Range {
+        const_iterator first;
+        const_iterator last;
+
+        const_iterator begin() const {
+            return first;
+        }
+
+        const_iterator end() const {
+            return last;
+        }
+    };
+
     BinaryTree() = default;
     ~BinaryTree();
 
@@ -22,8 +380,41 @@ class BinaryTree {
     BinaryTree& operator=(BinaryTree&&) = delete;
 
     void insert(Value& val);
+
+    // Заменяет содержимое идеально сбалансированным деревом из значений диапазона
+    template<typename Iterator>
+    void build_from(Iterator first, Iterator last);
+    void clear();
+
     void visit(Node* node);
     void print();
+
+    // Выводит все ключи через пробел, собирая вывод крупными блоками
+    template<typename Output>
+    void dump(Output& out) const;
+
+    const_iterator begin() const {
+        return const_iterator(this, leftmost(root));
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, nullptr);
+    }
+
+    // Первый ключ не меньше val
+    const_iterator lower_bound(const Value& val) const;
+    // Первый ключ больше val
+    const_iterator upper_bound(const Value& val) const;
+
+    // Ключи из [lo, hi)
+    Range range(const Value& lo, const Value& hi) const {
+        return Range{lower_bound(lo), lower_bound(hi)};
+    }
+
+    bool contains(const Value& val) const;
+
+    // Неизменяемая копия дерева без указателей
+    FrozenTree<Value> freeze() const;
     
     size_t get_height() const {
         return root->height;
@@ -31,25 +422,53 @@ class BinaryTree {
 
   private:
     Node* create_new(Value& val) {
-        Node* new_node = new Node;
+        Node* new_node = allocator.create();
         new_node->key = val;
         return new_node;
     }
 
+    static Node* leftmost(Node* node) {
+        while (node && node->left) {
+            node = node->left;
+        }
+        return node;
+    }
+
+    static Node* rightmost(Node* node) {
+        while (node && node->right) {
+            node = node->right;
+        }
+        return node;
+    }
+
+    static size_t height(Node* node) {
+        return node ? node->height : 0;
+    }
+
+    Node* build_balanced(std::vector<Value>& values, size_t begin, size_t end);
+
     void update_height(Node* node);
+    void fix_path(std::stack<Node*>& nodes);
+    Node* balance(Node* node);
+    Node* rotate_left(Node* node);
+    Node* rotate_right(Node* node);
       
     Node* root = nullptr;
+    Allocator<Node> allocator;
 };
 
 /**************************************************/
 
-template<typename Value>
-void BinaryTree<Value>::update_height(Node* node) {
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::update_height(Node* node) {
     if (!node->right || !node->left) {
         if (node->right) {
             node->height = node->right->height + 1;
         } else if (node->left) {
             node->height = node->left->height + 1;
+        } else {
+            // После поворота узел может снова стать листом
+            node->height = 1;
         }
         return;
     }
@@ -57,8 +476,18 @@ void BinaryTree<Value>::update_height(Node* node) {
     return;
 }
 
-template<typename Value>
-BinaryTree<Value>::~BinaryTree() {
+template<typename Value, template<typename> class Allocator, typename Balancing>
+BinaryTree<Value, Allocator, Balancing>::~BinaryTree() {
+    // Пул сам вернёт блоки, обходить дерево нужно только ради деструкторов ключей
+    if (Allocator<Node>::releases_all && std::is_trivially_destructible<Value>::value) {
+        root = nullptr;
+        return;
+    }
+    clear();
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::clear() {
     if (root) {
         std::stack<Node*> nodes;
         nodes.push(root);
@@ -81,15 +510,45 @@ BinaryTree<Value>::~BinaryTree() {
                         parent->right = nullptr;
                     }   
                 }
-                delete current;
+                allocator.destroy(current);
             }
         }
         root = nullptr;
     }
 }
 
-template<typename Value>
-void BinaryTree<Value>::insert(Value& val) {
+template<typename Value, template<typename> class Allocator, typename Balancing>
+template<typename Iterator>
+void BinaryTree<Value, Allocator, Balancing>::build_from(Iterator first, Iterator last) {
+    clear();
+    std::vector<Value> values(first, last);
+    parallel_sort(values);
+    root = build_balanced(values, 0, values.size());
+}
+
+// Середина отрезка становится корнем, каждое значение посещается один раз
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::Node* BinaryTree<Value, Allocator, Balancing>::build_balanced(std::vector<Value>& values, size_t begin, size_t end) {
+    if (begin == end) {
+        return nullptr;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    Node* node = allocator.create();
+    node->key = std::move(values[middle]);
+    node->left = build_balanced(values, begin, middle);
+    node->right = build_balanced(values, middle + 1, end);
+    if (node->left) {
+        node->left->parent = node;
+    }
+    if (node->right) {
+        node->right->parent = node;
+    }
+    update_height(node);
+    return node;
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::insert(Value& val) {
     if (!root) {
         root = create_new(val);
         return;
@@ -103,30 +562,18 @@ void BinaryTree<Value>::insert(Value& val) {
             nodes.push(node);
             node = node->right;
             if (!node) {
-                Node* parent = nodes.top();
-                nodes.pop();
-                parent->right = create_new(val);
-                update_height(parent);
-                while (!nodes.empty()) {
-                    parent = nodes.top();
-                    nodes.pop();
-                    update_height(parent);
-                } 
+                nodes.top()->right = create_new(val);
+                nodes.top()->right->parent = nodes.top();
+                fix_path(nodes);
                 return;
             }
         } else {
             nodes.push(node);
             node = node->left;
             if (!node) {
-                Node* parent = nodes.top();
-                nodes.pop();
-                parent->left = create_new(val);
-                update_height(parent);
-                while (!nodes.empty()) {
-                    parent = nodes.top();
-                    nodes.pop();
-                    update_height(parent);
-                } 
+                nodes.top()->left = create_new(val);
+                nodes.top()->left->parent = nodes.top();
+                fix_path(nodes);
                 return;
             }
         }
@@ -134,8 +581,79 @@ void BinaryTree<Value>::insert(Value& val) {
     return;
 }
 
-template<typename Value>
-void BinaryTree<Value>::visit(Node* node) {
+// Поднимается от места вставки к корню, пересчитывая высоты и балансируя узлы
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::fix_path(std::stack<Node*>& nodes) {
+    while (!nodes.empty()) {
+        Node* node = nodes.top();
+        nodes.pop();
+        update_height(node);
+        if (!Balancing::enabled) {
+            continue;
+        }
+
+        Node* subtree = balance(node);
+        if (subtree != node) {
+            if (nodes.empty()) {
+                root = subtree;
+            } else if (nodes.top()->left == node) {
+                nodes.top()->left = subtree;
+            } else {
+                nodes.top()->right = subtree;
+            }
+        }
+    }
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::Node* BinaryTree<Value, Allocator, Balancing>::balance(Node* node) {
+    if (height(node->right) == height(node->left) + 2) {
+        if (height(node->right->left) > height(node->right->right)) {
+            node->right = rotate_right(node->right);
+        }
+        return rotate_left(node);
+    }
+    if (height(node->left) == height(node->right) + 2) {
+        if (height(node->left->right) > height(node->left->left)) {
+            node->left = rotate_left(node->left);
+        }
+        return rotate_right(node);
+    }
+    return node;
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::Node* BinaryTree<Value, Allocator, Balancing>::rotate_left(Node* node) {
+    Node* new_root = node->right;
+    node->right = new_root->left;
+    if (node->right) {
+        node->right->parent = node;
+    }
+    new_root->left = node;
+    new_root->parent = node->parent;
+    node->parent = new_root;
+    update_height(node);
+    update_height(new_root);
+    return new_root;
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::Node* BinaryTree<Value, Allocator, Balancing>::rotate_right(Node* node) {
+    Node* new_root = node->left;
+    node->left = new_root->right;
+    if (node->left) {
+        node->left->parent = node;
+    }
+    new_root->right = node;
+    new_root->parent = node->parent;
+    node->parent = new_root;
+    update_height(node);
+    update_height(new_root);
+    return new_root;
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::visit(Node* node) {
     if (!node) {
         return;
     }
@@ -145,40 +663,149 @@ void BinaryTree<Value>::visit(Node* node) {
     visit(node->right);
 }
 
-template<typename Value>
-void BinaryTree<Value>::print() {
+template<typename Value, template<typename> class Allocator, typename Balancing>
+bool BinaryTree<Value, Allocator, Balancing>::contains(const Value& val) const {
     Node* node = root;
-    std::stack<Node*> nodes;
-    while (!nodes.empty() || node) {
-        if (node) {
-            nodes.push(node);
+    while (node) {
+        if (val < node->key) {
             node = node->left;
-        } else {
-            node = nodes.top();
-            nodes.pop();
-            std::cout << node->key << " ";
+        } else if (node->key < val) {
             node = node->right;
+        } else {
+            return true;
         }
-        
     }
+    return false;
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+FrozenTree<Value> BinaryTree<Value, Allocator, Balancing>::freeze() const {
+    std::vector<Value> sorted(begin(), end());
+    return FrozenTree<Value>(sorted);
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+void BinaryTree<Value, Allocator, Balancing>::print() {
+    dump(std::cout);
     std::cout << std::endl;
 }
 
+template<typename Value, template<typename> class Allocator, typename Balancing>
+template<typename Output>
+void BinaryTree<Value, Allocator, Balancing>::dump(Output& out) const {
+    static const size_t block_size = 1 << 16;
+    std::string buffer;
+    buffer.reserve(block_size + 64);
+    for (const Value& key : *this) {
+        if constexpr (std::is_integral<Value>::value) {
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof(digits), key);
+            buffer.append(digits, result.ptr);
+        } else {
+            std::ostringstream text;
+            text << key;
+            buffer += text.str();
+        }
+        buffer += ' ';
+        if (buffer.size() >= block_size) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::const_iterator BinaryTree<Value, Allocator, Balancing>::lower_bound(const Value& val) const {
+    Node* result = nullptr;
+    Node* node = root;
+    while (node) {
+        if (node->key < val) {
+            node = node->right;
+        } else {
+            result = node;
+            node = node->left;
+        }
+    }
+    return const_iterator(this, result);
+}
+
+template<typename Value, template<typename> class Allocator, typename Balancing>
+typename BinaryTree<Value, Allocator, Balancing>::const_iterator BinaryTree<Value, Allocator, Balancing>::upper_bound(const Value& val) const {
+    Node* result = nullptr;
+    Node* node = root;
+    while (node) {
+        if (val < node->key) {
+            result = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return const_iterator(this, result);
+}
+
 /**************************************************/
 
+#ifdef FROZEN_TREE_BENCH
+
+#include <chrono>
+#include <random>
+
+// Сравнение поиска по дереву с указателями и по замороженному: ./a.out [N] [queries]
+int main(int argc, char** argv) {
+    size_t N = (argc > 1) ? std::stoul(argv[1]) : (1 << 22);
+    size_t queries = (argc > 2) ? std::stoul(argv[2]) : (1 << 22);
+
+    std::mt19937 rng(42);
+    std::vector<int> values(N);
+    for (auto& value : values) {
+        value = static_cast<int>(rng());
+    }
+    std::vector<int> probes(queries);
+    for (auto& probe : probes) {
+        probe = values[rng() % N];
+    }
+
+    BinaryTree<int> tree;
+    tree.build_from(values.begin(), values.end());
+    FrozenTree<int> frozen = tree.freeze();
+
+    auto measure = [&](const char* name, auto&& contains) {
+        auto start = std::chrono::steady_clock::now();
+        size_t found = 0;
+        for (int probe : probes) {
+            found += contains(probe);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / queries << " ns/lookup (" << found << " found)" << std::endl;
+    };
+    measure("pointer tree", [&](int key) { return tree.contains(key); });
+    measure("frozen tree", [&](int key) { return frozen.contains(key); });
+    return 0;
+}
+
+#else
+
 int main() {
     BinaryTree<int> tree;
+    FastInput input;
+    FastOutput output;
 
     size_t N = 0;
-    std::cin >> N;
+    input.read(N);
 
+    // Печатается только обход по порядку, поэтому дерево строится сразу из всех значений
+    std::vector<int> values(N);
     for (size_t i = 0; i < N; i++) {
-        int tmp = 0;
-        std::cin >> tmp;
-        tree.insert(tmp);
+        input.read(values[i]);
     }
+    tree.build_from(values.begin(), values.end());
 
-    tree.print();
+    tree.dump(output);
+    output.write_char('\n');
 
     return 0;
 }
+
+#endif
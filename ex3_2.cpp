@@ -1,6 +1,21 @@
 #include <iostream>
 #include <stack>
 #include <cmath>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <type_traits>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "epoch_reclaim.h"
+#include "fast_io.h"
 
 
 /************ Бинарное дерево **************/
@@ -31,6 +46,11 @@ class BinaryTree {
         return root->height;
     }
 
+    // Средняя глубина узла, корень на глубине 1
+    double average_depth() const;
+
+    bool contains(const Value& val) const;
+
   private:
     Node* create_new(Value& val) {
         Node* new_node = new Node;
@@ -45,30 +65,40 @@ class BinaryTree {
 
 /************ Декартово дерево **************/
 
+/*
+ * Узел хранит высоту и размер своего поддерева. При LazyAugment = false
+ * они пересчитываются снизу вверх в split/merge/insert; при true узлы на
+ * изменённых путях только помечаются dirty, а пересчёт идёт по запросу
+ * и обходит лишь помеченные узлы. Чистый узел - всегда с чистым поддеревом.
+ */
 template<
     typename KType,
-    typename PType
+    typename PType,
+    bool LazyAugment = false
 >
 class CartesianTree {
     struct Node {
         KType key;
         PType priority;
+        size_t size = 1;
+        uint64_t depth_sum = 1;     // Сумма глубин узлов поддерева, сам узел на глубине 1
+        uint32_t height = 1;
+        bool dirty = false;
         Node* left = nullptr;
         Node* right = nullptr;
-
-        Node() = default;
-        ~Node() {
-            if (left) {
-                delete left;
-            }
-            if (right) {
-                delete right;
-            }
-        }
     };
 
   public:
+    struct DepthStats {
+        size_t size = 0;
+        size_t height = 0;
+        double average_depth = 0;
+        double height_ratio = 0;    // height / log2(size + 1)
+    };
+
     CartesianTree() = default;
+    // seed задаёт последовательность приоритетов для insert(key)
+    explicit CartesianTree(uint64_t seed) : priority_state(seed) {}
     ~CartesianTree();
     CartesianTree(const CartesianTree&) = delete;
     CartesianTree(CartesianTree&&) = delete;
@@ -77,14 +107,59 @@ class CartesianTree {
     
     void insert(KType key, PType priority);
 
+    // Приоритет берётся из splitmix64: ожидаемая глубина O(log n) не зависит
+    // от порядка ключей. Смешивать с явными приоритетами можно, если они
+    // из того же диапазона
+    void insert(KType key) {
+        insert(key, next_priority());
+    }
+
+    // Вставка через закэшированный правый край дерева. Амортизированное O(1)
+    // для ключа больше всех имеющихся только при LazyAugment: без него каждая
+    // вставка пересчитывает весь правый край, это O(log n), как у insert.
+    // Меньшие ключи ищутся от правого края, как в contains, и спуск тем
+    // короче, чем ближе ключ к максимуму; правый край при этом не сбрасывается
+    void finger_insert(KType key, PType priority);
+
+    void finger_insert(KType key) {
+        finger_insert(key, next_priority());
+    }
+
+    // Недавние (наибольшие) ключи ищутся от правого края, остальные - от корня
+    bool contains(KType key) const;
+
+    // Отсортированный по неубыванию отрезок ключей строится в дерево стеком
+    // за O(k) и сливается с текущим: merge, если все ключи больше имеющихся,
+    // иначе объединением за O(k log(n/k + 1)), которое, как и insert, сохраняет
+    // повторы. Пачки меньше fork_grain сливаются в одном потоке
+    template<typename Iterator>
+    void insert_sorted_batch(Iterator first, Iterator last);
+
+    // Теоретико-множественные операции слиянием по split/merge: работа O(m log(n/m + 1)),
+    // верхние уровни рекурсии идут в отдельных потоках, если оба поддерева
+    // не меньше fork_grain узлов; мелкие операции идут в одном потоке. Узлы other переходят
+    // в результат или удаляются, other остаётся пустым
+    void union_with(CartesianTree& other, size_t threads_count = std::thread::hardware_concurrency());
+    void intersect_with(CartesianTree& other, size_t threads_count = std::thread::hardware_concurrency());
+    void difference(CartesianTree& other, size_t threads_count = std::thread::hardware_concurrency());
+
     size_t get_height() const {
-        if (!root) {
-            return 0;
-        }
-        if (!root->right && !root->left) {
-            return 1;
-        }
-        return node_height(root);
+        refresh(root);
+        return root ? root->height : 0;
+    }
+
+    size_t size() const {
+        refresh(root);
+        return node_size(root);
+    }
+
+    DepthStats depth_stats() const;
+
+    // У дерева со случайными приоритетами высота около 3 log2 n,
+    // заметное превышение говорит о плохих приоритетах
+    bool is_degraded(double max_height_ratio = 4.0) const {
+        DepthStats stats = depth_stats();
+        return stats.size > 1 && stats.height_ratio > max_height_ratio;
     }
     
   private:
@@ -95,25 +170,103 @@ class CartesianTree {
         return new_node;
     }
 
-    size_t node_height(Node* node) const {
-        if(node == 0) {
-            return 0;
+    static size_t node_size(const Node* node) {
+        return node ? node->size : 0;
+    }
+
+    static uint32_t node_height(const Node* node) {
+        return node ? node->height : 0;
+    }
+
+    static uint64_t node_depth_sum(const Node* node) {
+        return node ? node->depth_sum : 0;
+    }
+
+    static void update(Node* node) {
+        node->size = node_size(node->left) + node_size(node->right) + 1;
+        // Узлы поддеревьев опускаются на уровень: каждый добавляет по единице
+        node->depth_sum = node_depth_sum(node->left) + node_depth_sum(node->right) + node->size;
+        node->height = std::max(node_height(node->left), node_height(node->right)) + 1;
+        node->dirty = false;
+    }
+
+    // Дети node уже на своих местах: пересчёт сразу или пометка для refresh
+    static void touch(Node* node) {
+        if constexpr (LazyAugment) {
+            node->dirty = true;
+        } else {
+            update(node);
         }
+    }
 
-        size_t left = 0, right = 0;
-        if (node->left) {
-            left = node_height(node->left);
+    // Узлы с изменёнными детьми в порядке спуска; в ленивом режиме путь не копится
+    static void track(std::vector<Node*>& path, Node* node) {
+        if constexpr (LazyAugment) {
+            node->dirty = true;
+        } else {
+            path.push_back(node);
         }
-        if (node->right) {
-            right = node_height(node->right);
+    }
+
+    static void update_path(std::vector<Node*>& path) {
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            update(*it);
         }
-        return std::max(left, right) + 1;
+        path.clear();
+    }
+
+    // У каждого потока свой буфер: split/merge зовутся из параллельных unite/intersect
+    static std::vector<Node*>& path_buffer() {
+        static thread_local std::vector<Node*> path;
+        return path;
+    }
+
+    static void refresh(Node* node);
+
+    PType next_priority() {
+        priority_state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = priority_state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        if constexpr (std::is_integral_v<PType>) {
+            // Неотрицательные значения во всём диапазоне типа
+            return static_cast<PType>(z >> (64 - std::numeric_limits<PType>::digits));
+        } else {
+            return static_cast<PType>(z >> 11) * static_cast<PType>(1.0 / 9007199254740992.0);
+        }
+    }
+
+    // strict: в левое дерево уходят только ключи < key
+    static std::pair<Node*, Node*> split(Node* current, KType key, bool strict = false);
+    static Node* merge(Node* left, Node* right);
+    static void destroy(Node* node);
+
+    // Меньше этого числа узлов в одном из входов поток дороже самой работы.
+    // В ленивом режиме размеры частей после split устаревшие, это оценка сверху
+    static constexpr size_t fork_grain = 1 << 13;
+
+    void insert_below_spine(KType key, PType priority);
+    void touch_spine(size_t count);
+
+    static size_t fork_depth(size_t threads_count);
+    static size_t grain_depth(const Node* first, const Node* second, size_t depth) {
+        return std::min(node_size(first), node_size(second)) < fork_grain ? 0 : depth;
     }
+    template<typename LeftTask, typename RightTask>
+    static void fork_join(size_t depth, LeftTask left_task, RightTask right_task);
 
-    std::pair<Node*, Node*> split(Node* current, KType key);
-    Node* merge(Node* left, Node* right);
+    // keep_duplicates: равные ключи не схлопываются, как при insert
+    static Node* unite(Node* first, Node* second, size_t depth, bool keep_duplicates = false);
+    static Node* intersect(Node* first, Node* second, size_t depth);
+    static Node* subtract(Node* first, Node* second, size_t depth);
 
     Node* root = nullptr;
+    std::vector<Node*> insert_path;
+    uint64_t priority_state = 0x2545F4914F6CDD1DULL;
+    // Путь от корня по правым детям; сбрасывается любой операцией, кроме finger_insert
+    std::vector<Node*> right_spine;
+    bool spine_valid = true;
 };
 
 /*********************** Методы бинарного дерева ***************************/
@@ -239,57 +392,133 @@ void BinaryTree<Value>::print() {
     std::cout << std::endl;
 }
 
-/********************** Методы декартового дерева ****************************/
+template<typename Value>
+double BinaryTree<Value>::average_depth() const {
+    if (!root) {
+        return 0;
+    }
+    size_t count = 0;
+    size_t depth_sum = 0;
+    std::stack<std::pair<Node*, size_t>> nodes;
+    nodes.push({root, 1});
+    while (!nodes.empty()) {
+        auto [node, depth] = nodes.top();
+        nodes.pop();
+        count++;
+        depth_sum += depth;
+        if (node->left) {
+            nodes.push({node->left, depth + 1});
+        }
+        if (node->right) {
+            nodes.push({node->right, depth + 1});
+        }
+    }
+    return static_cast<double>(depth_sum) / count;
+}
 
-template<typename KType, typename PType>
-CartesianTree<KType, PType>::~CartesianTree() {
-    delete root;
+// Равные ключи insert кладёт вправо, поэтому поиск идёт тем же правилом
+template<typename Value>
+bool BinaryTree<Value>::contains(const Value& val) const {
+    Node* node = root;
+    while (node) {
+        if (val == node->key) {
+            return true;
+        }
+        node = (val >= node->key) ? node->right : node->left;
+    }
+    return false;
 }
 
+/********************** Методы декартового дерева ****************************/
 
-template<typename KType, typename PType>
-typename CartesianTree<KType, PType>::Node* CartesianTree<KType, PType>::merge(Node* first, Node* second) {
-    if (first == nullptr) {
-        return second;
-    }
-    if (second == nullptr) {
-        return first;
+template<typename KType, typename PType, bool LazyAugment>
+CartesianTree<KType, PType, LazyAugment>::~CartesianTree() {
+    destroy(root);
+    root = nullptr;
+}
+
+// Левые поддеревья поворотами переносятся вправо, поэтому хватает O(1) памяти
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::destroy(Node* node) {
+    while (node) {
+        if (node->left) {
+            Node* left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        } else {
+            Node* right = node->right;
+            delete node;
+            node = right;
+        }
     }
-    if (first->priority <= second->priority) {
-        first->right = merge(second->right, second);
-        return first;
-    } else {
-        second->left = merge(first, second->left);
-        return second;
+}
+
+
+// Ключи first не больше ключей second; наверх поднимается больший приоритет
+template<typename KType, typename PType, bool LazyAugment>
+typename CartesianTree<KType, PType, LazyAugment>::Node* CartesianTree<KType, PType, LazyAugment>::merge(Node* first, Node* second) {
+    std::vector<Node*>& path = path_buffer();
+    Node* result = nullptr;
+    Node** tail = &result;
+    while (first && second) {
+        if (first->priority >= second->priority) {
+            track(path, first);
+            *tail = first;
+            tail = &first->right;
+            first = first->right;
+        } else {
+            track(path, second);
+            *tail = second;
+            tail = &second->left;
+            second = second->left;
+        }
     }
+    *tail = first ? first : second;
+    update_path(path);
+    return result;
 }
 
-template<typename KType, typename PType>
+// Спуск сверху вниз: узлы с ключом <= key дописываются к правому краю левого дерева,
+// остальные - к левому краю правого
+template<typename KType, typename PType, bool LazyAugment>
 std::pair<
-    typename CartesianTree<KType, PType>::Node*, 
-    typename CartesianTree<KType, PType>::Node*
+    typename CartesianTree<KType, PType, LazyAugment>::Node*, 
+    typename CartesianTree<KType, PType, LazyAugment>::Node*
 >
-CartesianTree<KType, PType>::split(Node* current, KType key) {
-    if (!current) {
-        return {nullptr, nullptr};
-    }
-    if (current->key <= key) {
-        auto res = split(current->right, key);
-        current->right = res.first;
-        return {current, res.second};
-    } else {
-        auto res = split(current->left, key);
-        current->left = res.second;
-        return {res.first, current};
+CartesianTree<KType, PType, LazyAugment>::split(Node* current, KType key, bool strict) {
+    std::vector<Node*>& path = path_buffer();
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node** left_tail = &left;
+    Node** right_tail = &right;
+    while (current) {
+        track(path, current);
+        if (strict ? current->key < key : current->key <= key) {
+            *left_tail = current;
+            left_tail = &current->right;
+            current = current->right;
+        } else {
+            *right_tail = current;
+            right_tail = &current->left;
+            current = current->left;
+        }
     }
+    *left_tail = nullptr;
+    *right_tail = nullptr;
+    update_path(path);
+    return {left, right};
 }
 
-template<typename KType, typename PType>
-void CartesianTree<KType, PType>::insert(const KType key, const PType priority) {
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::insert(const KType key, const PType priority) {
+    spine_valid = false;
     Node* parent = nullptr;
     Node* node = root;
+    insert_path.clear();
     while (node && node->priority >= priority) {
         parent = node;
+        track(insert_path, node);
         node = (node->key < key) ? node->right: node->left;
     }
 
@@ -297,6 +526,7 @@ void CartesianTree<KType, PType>::insert(const KType key, const PType priority)
     Node* new_node = create_node(key, priority);
     new_node->left = res.first;
     new_node->right = res.second;
+    touch(new_node);
 
     if (!parent) {
         root = new_node;
@@ -307,27 +537,1176 @@ void CartesianTree<KType, PType>::insert(const KType key, const PType priority)
             parent->right = new_node;
         }
     }
+    update_path(insert_path);
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+typename CartesianTree<KType, PType, LazyAugment>::DepthStats
+CartesianTree<KType, PType, LazyAugment>::depth_stats() const {
+    refresh(root);
+    DepthStats stats;
+    if (!root) {
+        return stats;
+    }
+    stats.size = root->size;
+    stats.height = root->height;
+    stats.average_depth = static_cast<double>(root->depth_sum) / root->size;
+    stats.height_ratio = stats.height / std::log2(static_cast<double>(stats.size) + 1);
+    return stats;
+}
+
+// Пересчёт только помеченных узлов: обратный порядок обхода в ширину
+// ставит детей раньше родителей
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::refresh(Node* node) {
+    if constexpr (LazyAugment) {
+        if (!node || !node->dirty) {
+            return;
+        }
+        std::vector<Node*>& order = path_buffer();
+        order.clear();
+        order.push_back(node);
+        for (size_t i = 0; i < order.size(); i++) {
+            Node* current = order[i];
+            if (current->left && current->left->dirty) {
+                order.push_back(current->left);
+            }
+            if (current->right && current->right->dirty) {
+                order.push_back(current->right);
+            }
+        }
+        update_path(order);
+    }
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+size_t CartesianTree<KType, PType, LazyAugment>::fork_depth(size_t threads_count) {
+    size_t depth = 0;
+    while ((static_cast<size_t>(2) << depth) <= threads_count) {
+        depth++;
+    }
+    return depth;
+}
+
+// Пока depth > 0, левая половина работы уходит в отдельный поток
+template<typename KType, typename PType, bool LazyAugment>
+template<typename LeftTask, typename RightTask>
+void CartesianTree<KType, PType, LazyAugment>::fork_join(size_t depth, LeftTask left_task, RightTask right_task) {
+    if (depth == 0) {
+        left_task();
+        right_task();
+        return;
+    }
+    std::thread worker(left_task);
+    right_task();
+    worker.join();
+}
+
+// Корнем становится узел с большим приоритетом, второе дерево режется по его ключу
+template<typename KType, typename PType, bool LazyAugment>
+typename CartesianTree<KType, PType, LazyAugment>::Node* CartesianTree<KType, PType, LazyAugment>::unite(Node* first, Node* second, size_t depth, bool keep_duplicates) {
+    if (!first) {
+        return second;
+    }
+    if (!second) {
+        return first;
+    }
+    depth = grain_depth(first, second, depth);
+    if (first->priority < second->priority) {
+        std::swap(first, second);
+    }
+
+    // Повторы ключа корня уходят влево, как в insert
+    auto less = split(second, first->key, !keep_duplicates);
+    auto equal = keep_duplicates ? std::make_pair(static_cast<Node*>(nullptr), less.second)
+                                 : split(less.second, first->key);
+    destroy(equal.first);
+
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* first_left = first->left;
+    Node* first_right = first->right;
+    fork_join(depth,
+        [&, depth] { left = unite(first_left, less.first, depth ? depth - 1 : 0, keep_duplicates); },
+        [&, depth] { right = unite(first_right, equal.second, depth ? depth - 1 : 0, keep_duplicates); });
+    first->left = left;
+    first->right = right;
+    touch(first);
+    return first;
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+typename CartesianTree<KType, PType, LazyAugment>::Node* CartesianTree<KType, PType, LazyAugment>::intersect(Node* first, Node* second, size_t depth) {
+    if (!first || !second) {
+        destroy(first);
+        destroy(second);
+        return nullptr;
+    }
+    depth = grain_depth(first, second, depth);
+    if (first->priority < second->priority) {
+        std::swap(first, second);
+    }
+
+    auto less = split(second, first->key, true);
+    auto equal = split(less.second, first->key);
+    bool found = equal.first != nullptr;
+    destroy(equal.first);
+
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* first_left = first->left;
+    Node* first_right = first->right;
+    fork_join(depth,
+        [&, depth] { left = intersect(first_left, less.first, depth ? depth - 1 : 0); },
+        [&, depth] { right = intersect(first_right, equal.second, depth ? depth - 1 : 0); });
+
+    if (!found) {
+        delete first;
+        return merge(left, right);
+    }
+    first->left = left;
+    first->right = right;
+    touch(first);
+    return first;
+}
+
+// Из first удаляются ключи second; узлы first сохраняют взаимный порядок приоритетов
+template<typename KType, typename PType, bool LazyAugment>
+typename CartesianTree<KType, PType, LazyAugment>::Node* CartesianTree<KType, PType, LazyAugment>::subtract(Node* first, Node* second, size_t depth) {
+    if (!first || !second) {
+        destroy(second);
+        return first;
+    }
+    depth = grain_depth(first, second, depth);
+
+    auto less = split(second, first->key, true);
+    auto equal = split(less.second, first->key);
+    bool found = equal.first != nullptr;
+    destroy(equal.first);
+
+    Node* left = nullptr;
+    Node* right = nullptr;
+    Node* first_left = first->left;
+    Node* first_right = first->right;
+    fork_join(depth,
+        [&, depth] { left = subtract(first_left, less.first, depth ? depth - 1 : 0); },
+        [&, depth] { right = subtract(first_right, equal.second, depth ? depth - 1 : 0); });
+
+    if (found) {
+        delete first;
+        return merge(left, right);
+    }
+    first->left = left;
+    first->right = right;
+    touch(first);
+    return first;
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::union_with(CartesianTree& other, size_t threads_count) {
+    // Порог по размерам читает size, поэтому ленивые пометки снимаются заранее
+    refresh(root);
+    refresh(other.root);
+    root = unite(root, other.root, fork_depth(threads_count));
+    other.root = nullptr;
+    spine_valid = false;
+    other.spine_valid = false;
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::intersect_with(CartesianTree& other, size_t threads_count) {
+    refresh(root);
+    refresh(other.root);
+    root = intersect(root, other.root, fork_depth(threads_count));
+    other.root = nullptr;
+    spine_valid = false;
+    other.spine_valid = false;
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::difference(CartesianTree& other, size_t threads_count) {
+    refresh(root);
+    refresh(other.root);
+    root = subtract(root, other.root, fork_depth(threads_count));
+    other.root = nullptr;
+    spine_valid = false;
+    other.spine_valid = false;
+}
+
+// Стековое построение декартова дерева: узлы с меньшим приоритетом снимаются
+// с правого края и становятся левым поддеревом нового узла
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::finger_insert(const KType key, const PType priority) {
+    if (!spine_valid) {
+        right_spine.clear();
+        for (Node* node = root; node; node = node->right) {
+            right_spine.push_back(node);
+        }
+        spine_valid = true;
+    }
+    if (!right_spine.empty() && !(right_spine.back()->key < key)) {
+        insert_below_spine(key, priority);
+        return;
+    }
+
+    Node* new_node = create_node(key, priority);
+    while (!right_spine.empty() && right_spine.back()->priority < priority) {
+        new_node->left = right_spine.back();
+        right_spine.pop_back();
+    }
+    touch(new_node);
+    if (right_spine.empty()) {
+        root = new_node;
+    } else {
+        right_spine.back()->right = new_node;
+    }
+
+    touch_spine(right_spine.size());
+    right_spine.push_back(new_node);
+}
+
+// Пересчёт первых count узлов правого края снизу вверх. Грязный узел означает
+// грязных предков, поэтому пометка останавливается на первом таком
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::touch_spine(size_t count) {
+    for (size_t i = count; i > 0; i--) {
+        if constexpr (LazyAugment) {
+            if (right_spine[i - 1]->dirty) {
+                break;
+            }
+        }
+        touch(right_spine[i - 1]);
+    }
+}
+
+// Ключ не больше максимума: путь поиска идёт по правому краю до next - первого
+// узла края с ключом не меньше key - и уходит в его левое поддерево
+template<typename KType, typename PType, bool LazyAugment>
+void CartesianTree<KType, PType, LazyAugment>::insert_below_spine(const KType key, const PType priority) {
+    size_t next = std::partition_point(right_spine.begin(), right_spine.end(),
+        [&](const Node* node) { return node->key < key; }) - right_spine.begin();
+    // Приоритеты на краю убывают вниз: первый узел с меньшим приоритетом
+    size_t place = std::partition_point(right_spine.begin(), right_spine.begin() + next + 1,
+        [&](const Node* node) { return node->priority >= priority; }) - right_spine.begin();
+
+    Node* new_node = create_node(key, priority);
+    if (place <= next) {
+        // Новый узел встаёт на край вместо right_spine[place]: узлы края с ключами
+        // не больше key уходят в его левую часть, правая начинается с right_spine[greater]
+        size_t greater = std::partition_point(right_spine.begin() + next, right_spine.end(),
+            [&](const Node* node) { return !(key < node->key); }) - right_spine.begin();
+        auto res = split(right_spine[place], key);
+        new_node->left = res.first;
+        new_node->right = res.second;
+        touch(new_node);
+        if (place == 0) {
+            root = new_node;
+        } else {
+            right_spine[place - 1]->right = new_node;
+        }
+        touch_spine(place);
+        if (place < greater) {
+            right_spine.erase(right_spine.begin() + place + 1, right_spine.begin() + greater);
+            right_spine[place] = new_node;
+        } else {
+            right_spine.insert(right_spine.begin() + place, new_node);
+        }
+        return;
+    }
+
+    // Край не меняется, спуск как в insert от левого ребёнка right_spine[next]
+    Node* parent = right_spine[next];
+    Node* node = parent->left;
+    insert_path.clear();
+    while (node && node->priority >= priority) {
+        parent = node;
+        track(insert_path, node);
+        node = (node->key < key) ? node->right: node->left;
+    }
+
+    auto res = split(node, key);
+    new_node->left = res.first;
+    new_node->right = res.second;
+    touch(new_node);
+    if (parent->key >= new_node->key) {
+        parent->left = new_node;
+    } else {
+        parent->right = new_node;
+    }
+    update_path(insert_path);
+    touch_spine(next + 1);
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+bool CartesianTree<KType, PType, LazyAugment>::contains(const KType key) const {
+    Node* node = root;
+    if (spine_valid && !right_spine.empty() && !(key < right_spine.front()->key)) {
+        // Ключи на правом краю растут вниз: начинаем с самого глубокого узла не больше key
+        size_t low = 0;
+        size_t high = right_spine.size();
+        while (high - low > 1) {
+            size_t middle = (low + high) / 2;
+            if (key < right_spine[middle]->key) {
+                high = middle;
+            } else {
+                low = middle;
+            }
+        }
+        node = right_spine[low];
+    }
+    while (node) {
+        if (key < node->key) {
+            node = node->left;
+        } else if (node->key < key) {
+            node = node->right;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename KType, typename PType, bool LazyAugment>
+template<typename Iterator>
+void CartesianTree<KType, PType, LazyAugment>::insert_sorted_batch(Iterator first, Iterator last) {
+    if (first == last) {
+        return;
+    }
+    // Снятый со стека узел больше не меняется, и его можно пересчитать
+    std::vector<Node*> stack;
+    for (; first != last; ++first) {
+        Node* new_node = create_node(*first, next_priority());
+        Node* last_popped = nullptr;
+        while (!stack.empty() && stack.back()->priority < new_node->priority) {
+            last_popped = stack.back();
+            stack.pop_back();
+            touch(last_popped);
+        }
+        new_node->left = last_popped;
+        if (!stack.empty()) {
+            stack.back()->right = new_node;
+        }
+        stack.push_back(new_node);
+    }
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+        touch(*it);
+    }
+    Node* batch = stack.front();
+
+    Node* rightmost = root;
+    while (rightmost && rightmost->right) {
+        rightmost = rightmost->right;
+    }
+    Node* leftmost = batch;
+    while (leftmost->left) {
+        leftmost = leftmost->left;
+    }
+    if (!rightmost || rightmost->key < leftmost->key) {
+        root = merge(root, batch);
+    } else {
+        refresh(root);
+        refresh(batch);
+        root = unite(root, batch, fork_depth(std::thread::hardware_concurrency()), true);
+    }
+    spine_valid = false;
+}
+
+/************ Неявное декартово дерево **************/
+
+/*
+ * Последовательность на декартовом дереве с неявным ключом: позиция
+ * элемента - число узлов левее него, поэтому split и merge режут
+ * по индексу. Разворот отрезка хранится ленивой меткой и спускается
+ * к детям при следующем проходе через узел.
+ */
+template<typename Value>
+class ImplicitTreap {
+    struct Node {
+        Value value;
+        uint32_t priority = 0;
+        size_t size = 1;
+        bool reversed = false;
+        Node* left = nullptr;
+        Node* right = nullptr;
+    };
+
+  public:
+    explicit ImplicitTreap(uint64_t seed = 0x9E3779B97F4A7C15ULL) : random_state(seed | 1) {}
+
+    ~ImplicitTreap() {
+        destroy(root);
+    }
+
+    ImplicitTreap(const ImplicitTreap&) = delete;
+    ImplicitTreap& operator=(const ImplicitTreap&) = delete;
+
+    ImplicitTreap(ImplicitTreap&& other)
+    :
+    random_state(other.random_state),
+    root(other.root) {
+        other.root = nullptr;
+    }
+
+    ImplicitTreap& operator=(ImplicitTreap&& other) {
+        if (this != &other) {
+            destroy(root);
+            root = other.root;
+            random_state = other.random_state;
+            other.root = nullptr;
+        }
+        return *this;
+    }
+
+    size_t size() const {
+        return node_size(root);
+    }
+
+    // Вставка перед элементом с индексом pos (pos == size() - в конец)
+    void insert_at(size_t pos, const Value& value) {
+        Node* node = new Node;
+        node->value = value;
+        node->priority = next_priority();
+        auto parts = split(root, pos);
+        root = merge(merge(parts.first, node), parts.second);
+    }
+
+    void erase_at(size_t pos) {
+        auto parts = split(root, pos);
+        auto rest = split(parts.second, 1);
+        destroy(rest.first);
+        root = merge(parts.first, rest.second);
+    }
+
+    // Элемент с индексом pos; метки разворота учитываются по пути без записи в узлы
+    const Value& at(size_t pos) const {
+        Node* node = root;
+        bool flip = false;
+        while (true) {
+            flip ^= node->reversed;
+            Node* left = flip ? node->right : node->left;
+            Node* right = flip ? node->left : node->right;
+            size_t left_size = node_size(left);
+            if (pos < left_size) {
+                node = left;
+            } else if (pos == left_size) {
+                return node->value;
+            } else {
+                pos -= left_size + 1;
+                node = right;
+            }
+        }
+    }
+
+    // Вырезает элементы [begin, end) в отдельное дерево
+    ImplicitTreap slice(size_t begin, size_t end) {
+        auto parts = split(root, begin);
+        auto middle = split(parts.second, end - begin);
+        root = merge(parts.first, middle.second);
+
+        ImplicitTreap result(next_random());
+        result.root = middle.first;
+        return result;
+    }
+
+    // Дописывает элементы other в конец, other остаётся пустым
+    void concat(ImplicitTreap& other) {
+        root = merge(root, other.root);
+        other.root = nullptr;
+    }
+
+    // Разворачивает отрезок [begin, end)
+    void reverse(size_t begin, size_t end) {
+        auto parts = split(root, begin);
+        auto middle = split(parts.second, end - begin);
+        if (middle.first) {
+            middle.first->reversed = !middle.first->reversed;
+        }
+        root = merge(parts.first, merge(middle.first, middle.second));
+    }
+
+    std::vector<Value> to_vector() {
+        std::vector<Value> values;
+        values.reserve(size());
+        std::vector<Node*> nodes;
+        Node* node = root;
+        while (!nodes.empty() || node) {
+            if (node) {
+                push(node);
+                nodes.push_back(node);
+                node = node->left;
+            } else {
+                node = nodes.back();
+                nodes.pop_back();
+                values.push_back(node->value);
+                node = node->right;
+            }
+        }
+        return values;
+    }
+
+  private:
+    static size_t node_size(Node* node) {
+        return node ? node->size : 0;
+    }
+
+    static void update(Node* node) {
+        node->size = node_size(node->left) + node_size(node->right) + 1;
+    }
+
+    // Спускает метку разворота к детям
+    static void push(Node* node) {
+        if (node->reversed) {
+            std::swap(node->left, node->right);
+            if (node->left) {
+                node->left->reversed = !node->left->reversed;
+            }
+            if (node->right) {
+                node->right->reversed = !node->right->reversed;
+            }
+            node->reversed = false;
+        }
+    }
+
+    uint64_t next_random() {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 7;
+        random_state ^= random_state << 17;
+        return random_state;
+    }
+
+    uint32_t next_priority() {
+        return static_cast<uint32_t>(next_random() >> 32);
+    }
+
+    // Первые count элементов и остальные. Спуск сверху вниз,
+    // размеры пересчитываются в обратном порядке по пройденному пути
+    std::pair<Node*, Node*> split(Node* current, size_t count) {
+        Node* left = nullptr;
+        Node* right = nullptr;
+        Node** left_tail = &left;
+        Node** right_tail = &right;
+        path.clear();
+        while (current) {
+            push(current);
+            path.push_back(current);
+            size_t left_size = node_size(current->left);
+            if (count > left_size) {
+                count -= left_size + 1;
+                *left_tail = current;
+                left_tail = &current->right;
+                current = current->right;
+            } else {
+                *right_tail = current;
+                right_tail = &current->left;
+                current = current->left;
+            }
+        }
+        *left_tail = nullptr;
+        *right_tail = nullptr;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            update(*it);
+        }
+        return {left, right};
+    }
+
+    Node* merge(Node* first, Node* second) {
+        Node* result = nullptr;
+        Node** tail = &result;
+        path.clear();
+        while (first && second) {
+            if (first->priority >= second->priority) {
+                push(first);
+                path.push_back(first);
+                *tail = first;
+                tail = &first->right;
+                first = first->right;
+            } else {
+                push(second);
+                path.push_back(second);
+                *tail = second;
+                tail = &second->left;
+                second = second->left;
+            }
+        }
+        *tail = first ? first : second;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            update(*it);
+        }
+        return result;
+    }
+
+    static void destroy(Node* node) {
+        while (node) {
+            if (node->left) {
+                Node* left = node->left;
+                node->left = left->right;
+                left->right = node;
+                node = left;
+            } else {
+                Node* right = node->right;
+                delete node;
+                node = right;
+            }
+        }
+    }
+
+    uint64_t random_state;
+    Node* root = nullptr;
+    std::vector<Node*> path;    // Путь последнего split/merge, чтобы не выделять память заново
+};
+
+/************ Персистентное декартово дерево **************/
+
+/*
+ * Узлы неизменяемы: insert копирует только узлы пути поиска и разреза,
+ * остальное делится со старой версией. Корень публикуется через атомарный
+ * указатель на держатель shared_ptr: снимок - это объявление эпохи, загрузка
+ * указателя и копия shared_ptr, без замков (std::atomic_load для shared_ptr
+ * в libstdc++ берёт спинлок). Старые держатели освобождает писатель, когда
+ * их не может видеть ни один читатель; версии дерева живут, пока живы снимки.
+ * Писатель должен быть один.
+ */
+template<typename KType, typename PType>
+class PersistentCartesianTree {
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        KType key;
+        PType priority;
+        NodePtr left;
+        NodePtr right;
+
+        Node(KType key, PType priority) : key(key), priority(priority) {}
+        Node(const Node&) = default;
+
+        // Длинные цепочки освобождаются циклом, а не рекурсией деструкторов:
+        // вложенный деструктор только откладывает детей, их отпускает самый внешний
+        ~Node() {
+            thread_local std::vector<NodePtr> pending;
+            thread_local bool draining = false;
+            if (left) {
+                pending.push_back(std::move(left));
+            }
+            if (right) {
+                pending.push_back(std::move(right));
+            }
+            if (draining) {
+                return;
+            }
+            draining = true;
+            while (!pending.empty()) {
+                NodePtr node = std::move(pending.back());
+                pending.pop_back();
+            }
+            draining = false;
+        }
+    };
+
+  public:
+    // Неизменяемая версия дерева; держит свои узлы живыми
+    class Snapshot {
+      public:
+        bool contains(KType key) const {
+            const Node* node = root.get();
+            while (node) {
+                if (key < node->key) {
+                    node = node->left.get();
+                } else if (node->key < key) {
+                    node = node->right.get();
+                } else {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Обход по уровням, как у CartesianTree до хранения высот в узлах
+        size_t get_height() const {
+            size_t height = 0;
+            std::vector<const Node*> level;
+            std::vector<const Node*> next_level;
+            if (root) {
+                level.push_back(root.get());
+            }
+            while (!level.empty()) {
+                height++;
+                next_level.clear();
+                for (const Node* current : level) {
+                    if (current->left) {
+                        next_level.push_back(current->left.get());
+                    }
+                    if (current->right) {
+                        next_level.push_back(current->right.get());
+                    }
+                }
+                level.swap(next_level);
+            }
+            return height;
+        }
+
+      private:
+        friend class PersistentCartesianTree;
+        explicit Snapshot(NodePtr root) : root(std::move(root)) {}
+
+        NodePtr root;
+    };
+
+    PersistentCartesianTree() : published(new NodePtr()) {}
+
+    ~PersistentCartesianTree() {
+        delete published.load();
+    }
+
+    PersistentCartesianTree(const PersistentCartesianTree&) = delete;
+    PersistentCartesianTree(PersistentCartesianTree&&) = delete;
+    PersistentCartesianTree& operator=(const PersistentCartesianTree&) = delete;
+    PersistentCartesianTree& operator=(PersistentCartesianTree&&) = delete;
+
+    void insert(KType key, PType priority);
+
+    // Можно звать из любого числа потоков одновременно с insert
+    Snapshot snapshot() const {
+        size_t slot = epochs.enter();
+        if (slot == ReaderSlots::none) {
+            std::lock_guard<std::mutex> guard(fallback_lock);
+            return Snapshot(*published.load(std::memory_order_acquire));
+        }
+        NodePtr current = *published.load(std::memory_order_acquire);
+        epochs.leave(slot);
+        return Snapshot(std::move(current));
+    }
+
+  private:
+    // Копии узлов разреза собираются сверху вниз, как в CartesianTree::split
+    static std::pair<NodePtr, NodePtr> split(NodePtr current, KType key);
+
+    NodePtr root;  // Текущая версия, её читает и меняет только писатель
+    std::atomic<NodePtr*> published;
+    RetireList retired;
+
+    EpochDomain epochs;
+    mutable std::mutex fallback_lock;  // Для потоков без номера читателя
+};
+
+template<typename KType, typename PType>
+std::pair<
+    typename PersistentCartesianTree<KType, PType>::NodePtr,
+    typename PersistentCartesianTree<KType, PType>::NodePtr
+>
+PersistentCartesianTree<KType, PType>::split(NodePtr current, KType key) {
+    NodePtr left;
+    NodePtr right;
+    NodePtr* left_tail = &left;
+    NodePtr* right_tail = &right;
+    while (current) {
+        auto copy = std::make_shared<Node>(*current);
+        if (current->key <= key) {
+            *left_tail = copy;
+            left_tail = &copy->right;
+            current = current->right;
+        } else {
+            *right_tail = copy;
+            right_tail = &copy->left;
+            current = current->left;
+        }
+    }
+    left_tail->reset();
+    right_tail->reset();
+    return {std::move(left), std::move(right)};
+}
+
+// Копии ещё не опубликованы, поэтому их дети правятся на месте
+template<typename KType, typename PType>
+void PersistentCartesianTree<KType, PType>::insert(const KType key, const PType priority) {
+    NodePtr current = root;
+    NodePtr new_root;
+    NodePtr* tail = &new_root;
+    while (current && current->priority >= priority) {
+        auto copy = std::make_shared<Node>(*current);
+        *tail = copy;
+        tail = (current->key < key) ? &copy->right : &copy->left;
+        current = *tail;
+    }
+
+    auto res = split(std::move(current), key);
+    auto new_node = std::make_shared<Node>(key, priority);
+    new_node->left = std::move(res.first);
+    new_node->right = std::move(res.second);
+    *tail = std::move(new_node);
+
+    root = std::move(new_root);
+    std::shared_ptr<NodePtr> old(published.exchange(new NodePtr(root), std::memory_order_acq_rel));
+    retired.retire(epochs.advance(), std::move(old));
+    // Читатель без номера копирует держатель под замком
+    std::lock_guard<std::mutex> guard(fallback_lock);
+    retired.reclaim(epochs);
 }
+
 /*********************** /main/ ***************************/
 
+#ifdef TREE_BENCH
+
+#include <chrono>
+#include <random>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+enum class Distribution {
+    Uniform,
+    Sorted,
+    Zipfian,
+    Adversarial
+};
+
+const char* distribution_name(Distribution distribution) {
+    switch (distribution) {
+        case Distribution::Uniform: return "uniform";
+        case Distribution::Sorted: return "sorted";
+        case Distribution::Zipfian: return "zipfian";
+        case Distribution::Adversarial: return "adversarial";
+    }
+    return "";
+}
+
+// Генератор Грея и др. (как в YCSB): ранг 0 самый частый, theta < 1
+class ZipfianGenerator {
+  public:
+    ZipfianGenerator(size_t n, double theta = 0.99)
+    :
+    n(static_cast<double>(n)),
+    theta(theta),
+    alpha(1 / (1 - theta)) {
+        for (size_t i = 1; i <= n; i++) {
+            zetan += 1 / std::pow(static_cast<double>(i), theta);
+        }
+        double zeta2 = 1 + 1 / std::pow(2.0, theta);
+        eta = (1 - std::pow(2 / this->n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    template<typename Rng>
+    uint64_t operator()(Rng& rng) {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        if (uz < 1) {
+            return 0;
+        }
+        if (uz < 1 + std::pow(0.5, theta)) {
+            return 1;
+        }
+        uint64_t rank = static_cast<uint64_t>(n * std::pow(eta * u - eta + 1, alpha));
+        return std::min(rank, static_cast<uint64_t>(n) - 1);
+    }
+
+  private:
+    double n;
+    double theta;
+    double alpha;
+    double zetan = 0;
+    double eta = 0;
+};
+
+// Вставляемые пары ключ-приоритет и ключи для поиска после вставок
+struct Workload {
+    std::vector<std::pair<int, int>> data;
+    std::vector<int> queries;
+};
+
+// Ранг в ключ: умножение на нечётное число - перестановка 32-битных чисел,
+// поэтому ключи различны, а соседние ранги разбросаны по всему диапазону
+int rank_key(uint64_t rank) {
+    return static_cast<int>(static_cast<uint32_t>(rank) * 2654435761u);
+}
+
+// adversarial - возрастающие ключи с убывающими приоритетами: обе структуры
+// вырождаются в цепочку, вставка за O(n). zipfian - различные ключи в случайном
+// порядке и n поисков с частотой по закону Ципфа: перекос в обращениях, а не
+// повторы ключей, которые превратили бы оба дерева в цепочки равных
+Workload generate(Distribution distribution, size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    Workload workload;
+    std::vector<std::pair<int, int>>& data = workload.data;
+    data.resize(n);
+    if (distribution == Distribution::Zipfian) {
+        std::vector<uint32_t> ranks(n);
+        for (size_t i = 0; i < n; i++) {
+            ranks[i] = static_cast<uint32_t>(i);
+        }
+        std::shuffle(ranks.begin(), ranks.end(), rng);
+        for (size_t i = 0; i < n; i++) {
+            data[i] = {rank_key(ranks[i]), static_cast<int>(rng())};
+        }
+        ZipfianGenerator zipf(n);
+        workload.queries.resize(n);
+        for (int& query : workload.queries) {
+            query = rank_key(zipf(rng));
+        }
+        return workload;
+    }
+    for (size_t i = 0; i < n; i++) {
+        switch (distribution) {
+            case Distribution::Uniform:
+                data[i] = {static_cast<int>(rng()), static_cast<int>(rng())};
+                break;
+            case Distribution::Sorted:
+                data[i] = {static_cast<int>(i), static_cast<int>(rng())};
+                break;
+            default:
+                data[i] = {static_cast<int>(i), static_cast<int>(n - i)};
+                break;
+        }
+    }
+    return workload;
+}
+
+// Промахи кэша через perf_event_open; без поддержки ядра счётчик недоступен
+class CacheMissCounter {
+  public:
+    CacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~CacheMissCounter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    CacheMissCounter(const CacheMissCounter&) = delete;
+    CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+    bool available() const {
+        return fd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // -1, если счётчик недоступен
+    long long stop() {
+        long long count = -1;
+#ifdef __linux__
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+                count = -1;
+            }
+        }
+#endif
+        return count;
+    }
+
+  private:
+    int fd = -1;
+};
+
+long peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct BenchResult {
+    double seconds = 0;
+    double lookup_seconds = 0;
+    size_t found = 0;
+    long long cache_misses = -1;
+    size_t height = 0;
+    double average_depth = 0;
+};
+
+// Вставки и поиски замеряются отдельно, счётчик промахов - только на вставках;
+// форма считается после остановки таймеров
+template<typename Tree, typename Insert, typename Shape>
+BenchResult measure_inserts(const Workload& workload, Insert insert, Shape shape) {
+    Tree tree;
+    CacheMissCounter counter;
+    BenchResult result;
+    auto start = std::chrono::steady_clock::now();
+    counter.start();
+    for (const auto& item : workload.data) {
+        insert(tree, item.first, item.second);
+    }
+    result.cache_misses = counter.stop();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int key : workload.queries) {
+        result.found += tree.contains(key);
+    }
+    result.lookup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    shape(tree, result);
+    return result;
+}
+
+BenchResult bench_binary_tree(const Workload& data) {
+    return measure_inserts<BinaryTree<int>>(data,
+        [](BinaryTree<int>& tree, int key, int) { tree.insert(key); },
+        [](const BinaryTree<int>& tree, BenchResult& result) {
+            result.height = tree.get_height();
+            result.average_depth = tree.average_depth();
+        });
+}
+
+BenchResult bench_cartesian_tree(const Workload& data) {
+    return measure_inserts<CartesianTree<int, int>>(data,
+        [](CartesianTree<int, int>& tree, int key, int priority) { tree.insert(key, priority); },
+        [](const CartesianTree<int, int>& tree, BenchResult& result) {
+            auto stats = tree.depth_stats();
+            result.height = stats.height;
+            result.average_depth = stats.average_depth;
+        });
+}
+
+// Приоритеты входа игнорируются, дерево берёт их из своего генератора
+BenchResult bench_seeded_cartesian_tree(const Workload& data) {
+    return measure_inserts<CartesianTree<int, int>>(data,
+        [](CartesianTree<int, int>& tree, int key, int) { tree.insert(key); },
+        [](const CartesianTree<int, int>& tree, BenchResult& result) {
+            auto stats = tree.depth_stats();
+            result.height = stats.height;
+            result.average_depth = stats.average_depth;
+        });
+}
+
+/*
+ * Каждый случай идёт в отдельном процессе: пиковый RSS из getrusage не
+ * смешивается между случаями, а падение одного не рвёт JSON. Потомок
+ * печатает объект целиком одним вызовом, с запятой, если он не первый.
+ */
+bool run_case(const char* structure, BenchResult (*bench)(const Workload&),
+              Distribution distribution, size_t n, bool first) {
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    }
+    if (pid == 0) {
+        Workload workload = generate(distribution, n, 42);
+        long input_rss_kb = peak_rss_kb();
+        BenchResult result = bench(workload);
+        char cache_misses[32] = "null";
+        if (result.cache_misses >= 0) {
+            std::snprintf(cache_misses, sizeof(cache_misses), "%lld", result.cache_misses);
+        }
+        char lookup_time_ns[32] = "null";
+        if (!workload.queries.empty()) {
+            std::snprintf(lookup_time_ns, sizeof(lookup_time_ns), "%.0f", result.lookup_seconds * 1e9);
+        }
+        std::printf("%s    {\"name\": \"%s/%s/%zu\", \"structure\": \"%s\", \"distribution\": \"%s\", "
+                    "\"n\": %zu, \"real_time_ns\": %.0f, \"items_per_second\": %.1f, "
+                    "\"lookups\": %zu, \"lookup_time_ns\": %s, \"lookups_found\": %zu, "
+                    "\"height\": %zu, \"average_depth\": %.3f, \"cache_misses\": %s, "
+                    "\"input_rss_kb\": %ld, \"peak_rss_kb\": %ld}",
+                    first ? "" : ",\n", structure, distribution_name(distribution), n, structure,
+                    distribution_name(distribution), n, result.seconds * 1e9, n / result.seconds,
+                    workload.queries.size(), lookup_time_ns, result.found,
+                    result.height, result.average_depth, cache_misses, input_rss_kb, peak_rss_kb());
+        std::fflush(stdout);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ./a.out [max_n] [quadratic_cap]: размеры 10^3, 10^4, ... до max_n, JSON в stdout.
+// Случаи с вставкой за O(n) (несбалансированное дерево на sorted и adversarial,
+// декартово с входными приоритетами на adversarial) ограничены quadratic_cap.
+// В zipfian ключи различны, перекос только в поисках, поэтому он не ограничен
+int main(int argc, char** argv) {
+    size_t max_n = (argc > 1) ? std::stoul(argv[1]) : 1000000;
+    size_t quadratic_cap = (argc > 2) ? std::stoul(argv[2]) : 20000;
+
+    struct Structure {
+        const char* name;
+        BenchResult (*bench)(const Workload&);
+        bool degenerates_on_sorted;
+        bool degenerates_on_adversarial;
+    };
+    const Structure structures[] = {
+        {"BinaryTree", bench_binary_tree, true, true},
+        {"CartesianTree", bench_cartesian_tree, false, true},
+        {"CartesianTree/seeded", bench_seeded_cartesian_tree, false, false},
+    };
+    const Distribution distributions[] = {
+        Distribution::Uniform,
+        Distribution::Sorted,
+        Distribution::Zipfian,
+        Distribution::Adversarial
+    };
+
+    std::printf("{\n  \"context\": {\"num_cpus\": %u, \"max_n\": %zu, \"quadratic_cap\": %zu, \"perf_events\": %s},\n"
+                "  \"benchmarks\": [\n",
+                std::thread::hardware_concurrency(), max_n, quadratic_cap,
+                CacheMissCounter().available() ? "true" : "false");
+    bool first = true;
+    for (const Structure& structure : structures) {
+        for (Distribution distribution : distributions) {
+            bool quadratic = (distribution == Distribution::Sorted && structure.degenerates_on_sorted) ||
+                             (distribution == Distribution::Adversarial && structure.degenerates_on_adversarial);
+            for (size_t n = 1000; n <= max_n; n *= 10) {
+                if (quadratic && n > quadratic_cap) {
+                    break;
+                }
+                if (run_case(structure.name, structure.bench, distribution, n, first)) {
+                    first = false;
+                }
+            }
+        }
+    }
+    std::printf("\n  ]\n}\n");
+    return 0;
+}
+
+#else
 
 int main() {
     BinaryTree<int> b_tree;
     CartesianTree<int, int> c_tree;
 
+    FastInput input;
+    FastOutput output;
+
     size_t N = 0;
-    std::cin >> N;
+    input.read(N);
     for (size_t i = 0; i < N; i++) {
         int key = 0;
         int priority = 0;
-        std::cin >> key >> priority;
+        input.read(key);
+        input.read(priority);
         b_tree.insert(key);
         c_tree.insert(key, priority);
     }
     int b_tree_height = static_cast<int>(b_tree.get_height());
     int c_tree_height = static_cast<int>(c_tree.get_height());
 
-    std::cout << std::abs(c_tree_height - b_tree_height) << std::endl; 
+    output.write_int(std::abs(c_tree_height - b_tree_height));
+    output.write_char('\n');
 
     return 0;
 }
+
+#endif
@@ -1,5 +1,10 @@
 #include <iostream>
 #include <stack>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+#include "fast_io.h"
 
 
 template<typename T>
@@ -250,21 +255,290 @@ typename AVLTree<T>::Node* AVLTree<T>::remove_min(Node* p) {
 }
 
 
+/*
+ * То же дерево порядковых статистик в компактной раскладке: узлы лежат
+ * подряд в одном векторе и ссылаются друг на друга 32-битными индексами
+ * (0 - пустая ссылка), вместо высоты хранится показатель баланса в двух
+ * битах рядом с 30-битным числом нод поддерева. Для int узел занимает
+ * 16 байт, четыре узла на кэш-линию. Предел - 2^30 - 1 элементов.
+ */
+template<typename T>
+class CompactAVLTree {
+    struct Node {
+        T key;
+        uint32_t left;
+        uint32_t right;
+        uint32_t meta;  // (nodes << 2) | (balance + 1), balance = h(right) - h(left)
+    };
+
+  public:
+    CompactAVLTree() : pool(1) {}
+
+    CompactAVLTree(const CompactAVLTree&) = delete;
+    CompactAVLTree(CompactAVLTree&&) = delete;
+    CompactAVLTree& operator=(const CompactAVLTree&) = delete;
+    CompactAVLTree& operator=(CompactAVLTree&&) = delete;
+
+    void reserve(size_t count) {
+        pool.reserve(count + 1);
+    }
+
+    void insert(T key, int& position) {
+        bool grew = false;
+        root = sub_insert(root, key, position, grew);
+    }
+
+    void remove(int pos) {
+        if (!root || static_cast<size_t>(pos) >= get_nodes(root)) {
+            return;
+        }
+        bool shrank = false;
+        root = sub_remove(root, static_cast<size_t>(pos), shrank);
+    }
+
+  private:
+    static constexpr uint32_t max_nodes = (1u << 30) - 1;
+
+    size_t get_nodes(uint32_t node) const {
+        return pool[node].meta >> 2;    // У пустой ссылки meta == 0
+    }
+
+    int get_balance(uint32_t node) const {
+        return static_cast<int>(pool[node].meta & 3) - 1;
+    }
+
+    void set_meta(uint32_t node, size_t nodes, int balance) {
+        pool[node].meta = (static_cast<uint32_t>(nodes) << 2) | static_cast<uint32_t>(balance + 1);
+    }
+
+    void set_balance(uint32_t node, int balance) {
+        set_meta(node, get_nodes(node), balance);
+    }
+
+    void fix_nodes(uint32_t node) {
+        set_meta(node, get_nodes(pool[node].left) + get_nodes(pool[node].right) + 1, get_balance(node));
+    }
+
+    uint32_t new_node(T key);
+    void free_node(uint32_t node);
+
+    uint32_t sub_insert(uint32_t p, T key, int& position, bool& grew);
+    uint32_t sub_remove(uint32_t p, size_t pos, bool& shrank);
+
+    // Показатель баланса p равен -2 / +2 и в узле не записан. height_dropped -
+    // уменьшилась ли высота поддерева относительно разбалансированного состояния
+    uint32_t fix_left_heavy(uint32_t p, bool& height_dropped);
+    uint32_t fix_right_heavy(uint32_t p, bool& height_dropped);
+
+    std::vector<Node> pool;     // pool[0] - пустой узел с нулевым числом нод
+    uint32_t free_list = 0;     // Освобождённые узлы, связанные через left
+    uint32_t root = 0;
+};
+
+template<typename T>
+uint32_t CompactAVLTree<T>::new_node(T key) {
+    uint32_t node = free_list;
+    if (node) {
+        free_list = pool[node].left;
+    } else {
+        if (pool.size() > max_nodes) {
+            throw std::length_error("CompactAVLTree: more than 2^30 - 1 nodes");
+        }
+        node = static_cast<uint32_t>(pool.size());
+        pool.emplace_back();
+    }
+    pool[node].key = key;
+    pool[node].left = 0;
+    pool[node].right = 0;
+    set_meta(node, 1, 0);
+    return node;
+}
+
+template<typename T>
+void CompactAVLTree<T>::free_node(uint32_t node) {
+    pool[node].left = free_list;
+    pool[node].meta = 0;
+    free_list = node;
+}
+
+// Индексы вместо ссылок: pool может переехать при вставке в глубине рекурсии
+template<typename T>
+uint32_t CompactAVLTree<T>::sub_insert(uint32_t p, T key, int& position, bool& grew) {
+    if (!p) {
+        grew = true;
+        return new_node(key);
+    }
+
+    set_meta(p, get_nodes(p) + 1, get_balance(p));
+
+    if (key < pool[p].key) {
+        position += get_nodes(pool[p].right) + 1;
+        uint32_t left = sub_insert(pool[p].left, key, position, grew);
+        pool[p].left = left;
+        if (grew) {
+            int balance = get_balance(p) - 1;
+            if (balance == -2) {
+                bool height_dropped = false;
+                p = fix_left_heavy(p, height_dropped);
+            } else {
+                set_balance(p, balance);
+            }
+            grew = balance == -1;
+        }
+    } else {
+        uint32_t right = sub_insert(pool[p].right, key, position, grew);
+        pool[p].right = right;
+        if (grew) {
+            int balance = get_balance(p) + 1;
+            if (balance == 2) {
+                bool height_dropped = false;
+                p = fix_right_heavy(p, height_dropped);
+            } else {
+                set_balance(p, balance);
+            }
+            grew = balance == 1;
+        }
+    }
+    return p;
+}
+
+template<typename T>
+uint32_t CompactAVLTree<T>::fix_left_heavy(uint32_t p, bool& height_dropped) {
+    uint32_t left = pool[p].left;
+    int left_balance = get_balance(left);
+    if (left_balance <= 0) {
+        // Малый правый поворот
+        pool[p].left = pool[left].right;
+        pool[left].right = p;
+        set_balance(p, left_balance == 0 ? -1 : 0);
+        set_balance(left, left_balance == 0 ? 1 : 0);
+        fix_nodes(p);
+        fix_nodes(left);
+        height_dropped = left_balance != 0;
+        return left;
+    }
+
+    // Большой правый поворот
+    uint32_t middle = pool[left].right;
+    int middle_balance = get_balance(middle);
+    pool[left].right = pool[middle].left;
+    pool[p].left = pool[middle].right;
+    pool[middle].left = left;
+    pool[middle].right = p;
+    set_balance(left, middle_balance == 1 ? -1 : 0);
+    set_balance(p, middle_balance == -1 ? 1 : 0);
+    set_balance(middle, 0);
+    fix_nodes(left);
+    fix_nodes(p);
+    fix_nodes(middle);
+    height_dropped = true;
+    return middle;
+}
+
+template<typename T>
+uint32_t CompactAVLTree<T>::fix_right_heavy(uint32_t p, bool& height_dropped) {
+    uint32_t right = pool[p].right;
+    int right_balance = get_balance(right);
+    if (right_balance >= 0) {
+        // Малый левый поворот
+        pool[p].right = pool[right].left;
+        pool[right].left = p;
+        set_balance(p, right_balance == 0 ? 1 : 0);
+        set_balance(right, right_balance == 0 ? -1 : 0);
+        fix_nodes(p);
+        fix_nodes(right);
+        height_dropped = right_balance != 0;
+        return right;
+    }
+
+    // Большой левый поворот
+    uint32_t middle = pool[right].left;
+    int middle_balance = get_balance(middle);
+    pool[right].left = pool[middle].right;
+    pool[p].right = pool[middle].left;
+    pool[middle].right = right;
+    pool[middle].left = p;
+    set_balance(right, middle_balance == -1 ? 1 : 0);
+    set_balance(p, middle_balance == 1 ? -1 : 0);
+    set_balance(middle, 0);
+    fix_nodes(right);
+    fix_nodes(p);
+    fix_nodes(middle);
+    height_dropped = true;
+    return middle;
+}
+
+// pos считается от наибольшего ключа, как в AVLTree::remove
+template<typename T>
+uint32_t CompactAVLTree<T>::sub_remove(uint32_t p, size_t pos, bool& shrank) {
+    uint32_t left = pool[p].left;
+    uint32_t right = pool[p].right;
+    size_t right_nodes = get_nodes(right);
+
+    if (pos == right_nodes) {
+        if (!left || !right) {
+            free_node(p);
+            shrank = true;
+            return left ? left : right;
+        }
+        // Ключ заменяется наименьшим из правого поддерева, удаляется уже тот узел
+        uint32_t min = right;
+        while (pool[min].left) {
+            min = pool[min].left;
+        }
+        pool[p].key = pool[min].key;
+        pos = right_nodes - 1;
+    }
+
+    set_meta(p, get_nodes(p) - 1, get_balance(p));
+
+    if (pos < right_nodes) {
+        pool[p].right = sub_remove(right, pos, shrank);
+        if (shrank) {
+            int balance = get_balance(p) - 1;
+            if (balance == -2) {
+                p = fix_left_heavy(p, shrank);
+            } else {
+                set_balance(p, balance);
+                shrank = balance == 0;
+            }
+        }
+    } else {
+        pool[p].left = sub_remove(left, pos - right_nodes - 1, shrank);
+        if (shrank) {
+            int balance = get_balance(p) + 1;
+            if (balance == 2) {
+                p = fix_right_heavy(p, shrank);
+            } else {
+                set_balance(p, balance);
+                shrank = balance == 0;
+            }
+        }
+    }
+    return p;
+}
+
 
 int main() {
+    FastInput input;
+    FastOutput output;
+
     size_t N = 0;
 
-    std::cin >> N;
+    input.read(N);
 
-    AVLTree<int> avl_tree;
+    CompactAVLTree<int> avl_tree;
+    avl_tree.reserve(N);
 
     for (size_t i = 0; i < N; i++) {
         int command = 0, key = 0, position = 0;
-        std::cin >> command >> key;
+        input.read(command);
+        input.read(key);
 
         if (command == 1) {
             avl_tree.insert(key, position);
-            std::cout << position << std::endl;
+            output.write_int(position);
+            output.write_char('\n');
         } else if (command == 2) {
             avl_tree.remove(key);
         }
@@ -0,0 +1,165 @@
+#ifndef FAST_IO_H
+#define FAST_IO_H
+
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <charconv>
+
+
+/************ Быстрый ввод-вывод **************/
+
+// Читает вход блоками, цифры разбираются по 8 за раз внутри 64-битного слова
+class FastInput {
+  public:
+    explicit FastInput(FILE* input = stdin, size_t block_size = 1 << 16)
+    :
+    input(input),
+    buffer(block_size + padding, 0) {}
+
+    FastInput(const FastInput&) = delete;
+    FastInput& operator=(const FastInput&) = delete;
+
+    // Целое со знаком или без; false, если вход закончился
+    template<typename T>
+    bool read(T& value) {
+        skip_spaces();
+        if (pos == end) {
+            return false;
+        }
+
+        bool negative = buffer[pos] == '-';
+        if (negative) {
+            pos++;
+        }
+        uint64_t result = 0;
+        uint64_t chunk = load_chunk();
+        while (all_digits(chunk)) {
+            result = result * 100000000 + parse_chunk(chunk);
+            pos += 8;
+            chunk = load_chunk();
+        }
+        while (pos < end && buffer[pos] >= '0' && buffer[pos] <= '9') {
+            result = result * 10 + (buffer[pos] - '0');
+            pos++;
+        }
+        value = static_cast<T>(negative ? 0 - result : result);
+        return true;
+    }
+
+  private:
+    // Длиннее не бывает ни одно 64-битное число
+    static constexpr size_t max_token_length = 32;
+    static constexpr size_t padding = 16;
+
+    uint64_t load_chunk() const {
+        uint64_t chunk;
+        std::memcpy(&chunk, buffer.data() + pos, sizeof(chunk));
+        return chunk;
+    }
+
+    static bool all_digits(uint64_t chunk) {
+        return (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+                 (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+                0x3333333333333333ULL);
+    }
+
+    // Восемь цифр (первая в младшем байте) складываются попарно за три умножения
+    static uint64_t parse_chunk(uint64_t chunk) {
+        chunk -= 0x3030303030303030ULL;
+        chunk = chunk * 10 + (chunk >> 8);
+        return (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+                (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    }
+
+    // Пропускает пробелы и следит, чтобы очередное число целиком лежало в буфере
+    void skip_spaces() {
+        while (true) {
+            while (pos < end && static_cast<unsigned char>(buffer[pos]) <= ' ') {
+                pos++;
+            }
+            if (eof || end - pos >= max_token_length) {
+                return;
+            }
+            refill();
+        }
+    }
+
+    void refill() {
+        std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+        end -= pos;
+        pos = 0;
+        size_t read = std::fread(buffer.data() + end, 1, buffer.size() - padding - end, input);
+        if (read == 0) {
+            eof = true;
+        }
+        end += read;
+        // За концом данных нули: слово из 8 байт не примет их за цифры
+        std::memset(buffer.data() + end, 0, padding);
+    }
+
+    FILE* input;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+// Копит вывод в большом буфере и сбрасывает его целиком
+class FastOutput {
+  public:
+    explicit FastOutput(FILE* output = stdout, size_t block_size = 1 << 16)
+    :
+    output(output),
+    buffer(block_size) {}
+
+    FastOutput(const FastOutput&) = delete;
+    FastOutput& operator=(const FastOutput&) = delete;
+
+    ~FastOutput() {
+        flush();
+    }
+
+    void write(const char* data, size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+            if (size > buffer.size()) {
+                std::fwrite(data, 1, size, output);
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    void write_char(char c) {
+        if (used == buffer.size()) {
+            flush();
+        }
+        buffer[used++] = c;
+    }
+
+    template<typename T>
+    void write_int(T value) {
+        if (used + max_int_length > buffer.size()) {
+            flush();
+        }
+        used = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value).ptr - buffer.data();
+    }
+
+    void flush() {
+        std::fwrite(buffer.data(), 1, used, output);
+        std::fflush(output);
+        used = 0;
+    }
+
+  private:
+    static constexpr size_t max_int_length = 24;
+
+    FILE* output;
+    std::vector<char> buffer;
+    size_t used = 0;
+};
+
+#endif  // FAST_IO_H